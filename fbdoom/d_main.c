@@ -285,12 +285,14 @@ void D_Display (void)
     // draw pause pic
     if (paused)
     {
+		static int pauselump = -1;
+
 		if (automapactive)
 			y = 4;
 		else
 			y = viewwindowy+4;
 		V_DrawPatchDirect(viewwindowx + (scaledviewwidth - 68) / 2, y,
-							  W_CacheLumpName (DEH_String("M_PAUSE"), PU_CACHE));
+							  W_CacheLumpNameCached (DEH_String("M_PAUSE"), &pauselump, PU_CACHE));
     }
 
 
@@ -454,6 +456,9 @@ void D_DoomLoop (void)
 		{
 			D_Display ();
 		}
+
+		// nothing holds a purgable block between frames
+		Z_Compact ();
     }
 }
 
@@ -592,6 +597,9 @@ void D_DoAdvanceDemo (void)
 //
 void D_StartTitle (void)
 {
+    // the level is left without loading another
+    P_CancelPrefetch ();
+
     gameaction = ga_nothing;
     demosequence = -1;
     D_AdvanceDemo ();
@@ -171,8 +171,10 @@ typedef struct
 
 // BSP node structure.
 
-// Indicate a leaf.
-#define	NF_SUBSECTOR	0x8000
+// Indicate a leaf.  The map lumps use the low 16 bits for the
+// index and NF_SUBSECTOR_VANILLA, the loaded nodes the full 32.
+#define	NF_SUBSECTOR		0x80000000
+#define	NF_SUBSECTOR_VANILLA	0x8000
 
 typedef struct
 {
@@ -194,6 +196,56 @@ typedef struct
 
 
 
+// DeePBSP's extended nodes, for maps past the 16 bit limits.
+// NODES starts with NODES_DEEPBSP_MAGIC, followed by the nodes;
+// SEGS and SSECTORS hold the segs and subsectors as below.
+#define NODES_DEEPBSP_MAGIC	"xNd4\0\0\0\0"
+
+typedef struct
+{
+  unsigned short	numsegs;
+  int		firstseg;
+} PACKEDATTR mapsubsector_v4_t;
+
+typedef struct
+{
+  int		v1;
+  int		v2;
+  short		angle;
+  unsigned short	linedef;
+  short		side;
+  unsigned short	offset;
+} PACKEDATTR mapseg_v4_t;
+
+typedef struct
+{
+  short		x;
+  short		y;
+  short		dx;
+  short		dy;
+  short		bbox[2][4];
+  // NF_SUBSECTOR in the top bit, as in node_t
+  unsigned int	children[2];
+} PACKEDATTR mapnode_v4_t;
+
+
+// ZDBSP's uncompressed extended nodes.  Everything is in the
+// NODES lump after NODES_XNOD_MAGIC: the vertexes the node
+// builder added, then the subsectors, segs and nodes, each as
+// a count and an array.  Nodes are laid out as mapnode_v4_t.
+#define NODES_XNOD_MAGIC	"XNOD"
+#define NODES_ZNOD_MAGIC	"ZNOD"	// the same, zlib compressed
+
+typedef struct
+{
+  unsigned int	v1;
+  unsigned int	v2;
+  unsigned short	linedef;
+  unsigned char	side;
+} PACKEDATTR mapseg_xnod_t;
+
+
+
 
 // Thing definition, position, orientation and type,
 // plus skill/visibility flags and attributes.
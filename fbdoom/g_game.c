@@ -1389,6 +1389,7 @@ void G_DoCompleted (void)
     {
 	// victory 
 	gameaction = ga_victory; 
+	P_CancelPrefetch ();
 	return; 
     } 
 	 
@@ -1484,6 +1485,12 @@ void G_DoCompleted (void)
 
     StatCopy(&wminfo);
  
+    // MAP30 ends the game, no level follows
+    if (gamemode == commercial && gamemap == 30)
+	P_CancelPrefetch ();
+    else
+	P_PrefetchLevel (gameepisode, wminfo.next+1);
+
     WI_Start (&wminfo); 
 } 
 
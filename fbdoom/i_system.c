@@ -55,8 +55,17 @@
 #include <CoreFoundation/CFUserNotification.h>
 #endif
 
-#define DEFAULT_RAM 6 /* MiB */
-#define MIN_RAM     6  /* MiB */
+#define DEFAULT_RAM 4  /* MiB */
+#define MIN_RAM     4  /* MiB */
+#define MAX_RAM     16 /* MiB */
+#define GROW_RAM    1  /* MiB */
+
+// bytes allocated for the zone so far, and the most it may grow to
+static int zonetotal;
+static int zoneceiling;
+
+// print the memory use as the zone grows and shrinks
+static boolean zonestats;
 
 
 typedef struct atexit_listentry_s atexit_listentry_t;
@@ -130,16 +139,60 @@ static byte *AutoAllocMemory(int *size, int default_ram, int min_ram)
     return zonemem;
 }
 
+// Print the size of the zone and the memory use of the whole
+// process, as far as the system lets us find out.
+
+static void PrintZoneMemory(char *what)
+{
+    FILE *f;
+    char line[80];
+    int rss, peak;
+
+    rss = peak = -1;
+
+    f = fopen("/proc/self/status", "r");
+
+    if (f != NULL)
+    {
+        while (fgets(line, sizeof(line), f) != NULL)
+        {
+            sscanf(line, "VmRSS: %i", &rss);
+            sscanf(line, "VmHWM: %i", &peak);
+        }
+
+        fclose(f);
+    }
+
+    printf("zone memory: %s, %i KiB allocated for zone", what, zonetotal / 1024);
+
+    if (rss >= 0 && peak >= 0)
+    {
+        printf(", rss %i KiB (peak %i KiB)", rss, peak);
+    }
+
+    printf("\n");
+}
+
+static void I_PrintPeakMemory(void)
+{
+    if (zonestats)
+    {
+        PrintZoneMemory("at exit");
+    }
+}
+
 byte *I_ZoneBase (int *size)
 {
     byte *zonemem;
-    int min_ram, default_ram;
+    int min_ram, default_ram, max_ram;
     int p;
 
     //!
     // @arg <mb>
     //
-    // Specify the heap size, in MiB (default 16).
+    // Specify the heap size, in MiB.  By default the heap starts at
+    // 4 MiB and grows as needed up to 16 MiB; a heap sized with -mb
+    // only grows past it when -maxmb is given.
     //
 
     p = M_CheckParmWithArgs("-mb", 1);
@@ -148,21 +201,96 @@ byte *I_ZoneBase (int *size)
     {
         default_ram = atoi(myargv[p+1]);
         min_ram = default_ram;
+        max_ram = default_ram;
     }
     else
     {
         default_ram = DEFAULT_RAM;
         min_ram = MIN_RAM;
+        max_ram = MAX_RAM;
+    }
+
+    //!
+    // @arg <mb>
+    //
+    // Let the heap grow when it runs out, up to this size in MiB.
+    //
+
+    p = M_CheckParmWithArgs("-maxmb", 1);
+
+    if (p > 0)
+    {
+        max_ram = atoi(myargv[p+1]);
     }
 
+    zonestats = M_CheckParm("-zonestats") > 0;
+
     zonemem = AutoAllocMemory(size, default_ram, min_ram);
 
+    zonetotal = *size;
+    zoneceiling = max_ram * 1024 * 1024;
+
+    if (zoneceiling < zonetotal)
+    {
+        zoneceiling = zonetotal;
+    }
+
     printf("zone memory: %p, %x allocated for zone\n", 
            zonemem, *size);
 
+    I_AtExit(I_PrintPeakMemory, false);
+
     return zonemem;
 }
 
+//
+// I_ZoneRegion
+// Allocates another region of at least *size bytes for the zone,
+// or returns NULL if that would take the zone past its ceiling.
+//
+
+byte *I_ZoneRegion (int *size)
+{
+    byte *region;
+    int step;
+
+    step = GROW_RAM * 1024 * 1024;
+    *size = (*size + step - 1) / step * step;
+
+    if (*size > zoneceiling - zonetotal)
+    {
+        return NULL;
+    }
+
+    region = malloc(*size);
+
+    if (region == NULL)
+    {
+        return NULL;
+    }
+
+    zonetotal += *size;
+
+    if (zonestats)
+    {
+        PrintZoneMemory("grown");
+    }
+
+    return region;
+}
+
+void I_FreeZoneRegion (byte *region, int size)
+{
+    free(region);
+
+    zonetotal -= size;
+
+    if (zonestats)
+    {
+        PrintZoneMemory("shrunk");
+    }
+}
+
 void I_PrintBanner(char *msg)
 {
     int i;
@@ -34,6 +34,11 @@ void I_Init (void);
 // for the zone management.
 byte*	I_ZoneBase (int *size);
 
+// Called when the zone runs out of room, and when a
+// region is no longer used.
+byte*	I_ZoneRegion (int *size);
+void	I_FreeZoneRegion (byte *region, int size);
+
 boolean I_ConsoleStdout(void);
 
 
@@ -166,6 +166,7 @@ short		whichSkull;		// which skull to draw
 // graphic name of skulls
 // warning: initializer-string for array of chars is too long
 char    *skullName[2] = {"M_SKULL1","M_SKULL2"};
+static int skulllumps[2] = { -1, -1 };
 
 // current menudef
 menu_t*	currentMenu;                          
@@ -548,20 +549,26 @@ void M_DrawLoad(void)
 //
 void M_DrawSaveLoadBorder(int x,int y)
 {
+    static int      leftlump = -1;
+    static int      centerlump = -1;
+    static int      rightlump = -1;
     int             i;
 	
     V_DrawPatchDirect(x - 8, y + 7,
-                      W_CacheLumpName(DEH_String("M_LSLEFT"), PU_CACHE));
+                      W_CacheLumpNameCached(DEH_String("M_LSLEFT"), &leftlump,
+                                            PU_CACHE));
 	
     for (i = 0;i < 24;i++)
     {
 	V_DrawPatchDirect(x, y + 7,
-                          W_CacheLumpName(DEH_String("M_LSCNTR"), PU_CACHE));
+                          W_CacheLumpNameCached(DEH_String("M_LSCNTR"), &centerlump,
+                                                PU_CACHE));
 	x += 8;
     }
 
     V_DrawPatchDirect(x, y + 7, 
-                      W_CacheLumpName(DEH_String("M_LSRGHT"), PU_CACHE));
+                      W_CacheLumpNameCached(DEH_String("M_LSRGHT"), &rightlump,
+                                            PU_CACHE));
 }
 
 
@@ -1247,21 +1254,26 @@ M_DrawThermo
   int	thermWidth,
   int	thermDot )
 {
+    static int	thermlumps[4] = { -1, -1, -1, -1 };
     int		xx;
     int		i;
 
     xx = x;
-    V_DrawPatchDirect(xx, y, W_CacheLumpName(DEH_String("M_THERML"), PU_CACHE));
+    V_DrawPatchDirect(xx, y, W_CacheLumpNameCached(DEH_String("M_THERML"),
+                                                  &thermlumps[0], PU_CACHE));
     xx += 8;
     for (i=0;i<thermWidth;i++)
     {
-	V_DrawPatchDirect(xx, y, W_CacheLumpName(DEH_String("M_THERMM"), PU_CACHE));
+	V_DrawPatchDirect(xx, y, W_CacheLumpNameCached(DEH_String("M_THERMM"),
+                                                  &thermlumps[1], PU_CACHE));
 	xx += 8;
     }
-    V_DrawPatchDirect(xx, y, W_CacheLumpName(DEH_String("M_THERMR"), PU_CACHE));
+    V_DrawPatchDirect(xx, y, W_CacheLumpNameCached(DEH_String("M_THERMR"),
+                                                  &thermlumps[2], PU_CACHE));
 
     V_DrawPatchDirect((x + 8) + thermDot * 8, y,
-		      W_CacheLumpName(DEH_String("M_THERMO"), PU_CACHE));
+		      W_CacheLumpNameCached(DEH_String("M_THERMO"),
+					    &thermlumps[3], PU_CACHE));
 }
 
 
@@ -1271,8 +1283,11 @@ M_DrawEmptyCell
 ( menu_t*	menu,
   int		item )
 {
+    static int	celllump = -1;
+
     V_DrawPatchDirect(menu->x - 10, menu->y + item * LINEHEIGHT - 1, 
-                      W_CacheLumpName(DEH_String("M_CELL1"), PU_CACHE));
+                      W_CacheLumpNameCached(DEH_String("M_CELL1"), &celllump,
+                                            PU_CACHE));
 }
 
 void
@@ -1280,8 +1295,11 @@ M_DrawSelCell
 ( menu_t*	menu,
   int		item )
 {
+    static int	celllump = -1;
+
     V_DrawPatchDirect(menu->x - 10, menu->y + item * LINEHEIGHT - 1,
-                      W_CacheLumpName(DEH_String("M_CELL2"), PU_CACHE));
+                      W_CacheLumpNameCached(DEH_String("M_CELL2"), &celllump,
+                                            PU_CACHE));
 }
 
 
@@ -2030,8 +2048,8 @@ void M_Drawer (void)
     
     // DRAW SKULL
     V_DrawPatchDirect(x + SKULLXOFF, currentMenu->y - 5 + itemOn*LINEHEIGHT,
-		      W_CacheLumpName(DEH_String(skullName[whichSkull]),
-				      PU_CACHE));
+		      W_CacheLumpNameCached(DEH_String(skullName[whichSkull]),
+					    &skulllumps[whichSkull], PU_CACHE));
 }
 
 
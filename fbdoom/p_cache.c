@@ -0,0 +1,624 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Level cache: the lines, segs, sector line lists, blockmap
+//	and reject matrix built by P_SetupLevel, saved to disk and
+//	loaded back on the next visit to the same map.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "z_zone.h"
+
+#include "doomtype.h"
+#include "i_swap.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "sha1.h"
+#include "w_checksum.h"
+#include "w_wad.h"
+
+#include "doomdef.h"
+#include "doomdata.h"
+#include "p_local.h"
+
+#include "r_state.h"
+
+// Bump when the layout or contents of a cache file change.
+#define LEVELCACHE_VERSION	4
+
+//
+// A cache file is a header followed by the arrays it points
+//  to, each at a byte offset from the start of the file.
+// The arrays are in memory layout, with every pointer stored
+//  as an index: 0 for NULL, i+1 for element i of the array it
+//  points into, and -1 for the sector at null address.  They
+//  are used in place once P_RelocateLevelCache has turned the
+//  indices back into pointers, in one pass per array.
+//
+// The file is keyed on the WADs in use, as rtables.dat is (see
+//  W_Checksum), along with the map's name, lump number and lump
+//  sizes, the contents of the small map lumps, the size and time
+//  of the file holding the reject and blockmap, the structure
+//  sizes and the version.  The key names the file and is kept
+//  in it.  Nothing in the file is trusted until its arrays are
+//  found to lie inside it and its indices inside the level.
+//
+typedef struct
+{
+    char	magic[8];
+    sha1_digest_t key;
+
+    int		numvertexes;
+    int		numsectors;
+    int		numsides;
+    int		numlines;
+    int		numsegs;
+    int		numsubsectors;
+    int		totallines;
+
+    int		linesofs;	// line_t[numlines]
+    int		segsofs;	// seg_t[numsegs]
+    int		linebufferofs;	// line_t*[totallines]
+    int		sectorsofs;	// cachedsector_t[numsectors]
+    int		subsectorsofs;	// int[numsubsectors], sector index
+    int		blockmapofs;	// int32_t[blockmaplen]
+    int		blockmaplen;
+    int		rejectofs;	// byte[rejectlen], padded
+    int		rejectlen;
+
+    int		length;		// of the whole file
+} levelcache_t;
+
+// What P_GroupLines leaves in a sector.
+typedef struct
+{
+    int		linecount;
+    int		lines;		// index into the line buffer
+    int		blockbox[4];
+    fixed_t	soundorgx;
+    fixed_t	soundorgy;
+} cachedsector_t;
+
+static const char levelcache_magic[8] = "FBLEVEL";
+
+static boolean levelcache_enabled;
+
+// W_Checksum of the WADs in use
+static sha1_digest_t levelcache_wads;
+
+// Key of the level being set up, see LevelCacheName.
+static sha1_digest_t levelcache_key;
+
+// Cache file of the level being set up, see P_ReadLevelCache.
+static char *levelcache_file = NULL;
+
+#define ENCODE(p, base)	((void *) ((p) == NULL ? 0 : (intptr_t) ((p) - (base)) + 1))
+#define DECODE(p, base)	((p) == NULL ? NULL : &(base)[(intptr_t) (p) - 1])
+
+#define NULLSECTOR	((sector_t *) (intptr_t) -1)
+
+
+
+//
+// P_InitLevelCache
+//
+void P_InitLevelCache (void)
+{
+    //!
+    // Do not save or load the precomputed level cache.
+    //
+
+    levelcache_enabled = !M_CheckParm ("-nolevelcache");
+
+    if (levelcache_enabled)
+	W_Checksum (levelcache_wads);
+}
+
+//
+// HashLump
+// Adds the contents of a lump to the key.
+//
+static void HashLump (sha1_context_t *context, int lump)
+{
+    int		length;
+
+    length = W_LumpLength (lump);
+    SHA1_UpdateInt32 (context, length);
+
+    if (length > 0)
+    {
+	SHA1_Update (context, W_CacheLumpNum (lump, PU_CACHE), length);
+	W_ReleaseLumpNum (lump);
+    }
+}
+
+//
+// LevelCacheName
+// Path of the cache file for the map at lumpnum, whose key is
+//  left in levelcache_key.
+// The returned value must be freed with free() after use.
+//
+static char *LevelCacheName (int lumpnum)
+{
+    static const char hex[] = "0123456789abcdef";
+    sha1_context_t	context;
+    sha1_digest_t	digest;
+    char		name[sizeof(digest) * 2 + 5];
+    char		lumpname[9];
+    char		*dir;
+    char		*result;
+    unsigned int	i;
+
+    SHA1_Init (&context);
+    SHA1_Update (&context, levelcache_wads, sizeof(levelcache_wads));
+    SHA1_UpdateInt32 (&context, LEVELCACHE_VERSION);
+    SHA1_UpdateInt32 (&context, sizeof(void *));
+    SHA1_UpdateInt32 (&context, sizeof(line_t));
+    SHA1_UpdateInt32 (&context, sizeof(seg_t));
+
+    // The reject padding depends on this, see PadRejectArray.
+    SHA1_UpdateInt32 (&context, M_CheckParm ("-reject_pad_with_ff") != 0);
+
+    // And the blockmap on this, see P_LoadBlockMap.
+    SHA1_UpdateInt32 (&context, M_CheckParm ("-blockmap") != 0);
+
+    M_StringCopy (lumpname, lumpinfo[lumpnum].name, sizeof(lumpname));
+    SHA1_UpdateString (&context, lumpname);
+    SHA1_UpdateInt32 (&context, lumpnum);
+
+    for (i=ML_THINGS ; i<=ML_BLOCKMAP ; i++)
+	SHA1_UpdateInt32 (&context, W_LumpLength (lumpnum+i));
+
+    // Everything the cache is built from, bar the reject and
+    //  blockmap, is small enough to hash on every load.  An edit
+    //  to a WAD that keeps the lump sizes the same still gives a
+    //  new key.
+    HashLump (&context, lumpnum+ML_VERTEXES);
+    HashLump (&context, lumpnum+ML_SECTORS);
+    HashLump (&context, lumpnum+ML_SIDEDEFS);
+    HashLump (&context, lumpnum+ML_LINEDEFS);
+    HashLump (&context, lumpnum+ML_SEGS);
+    HashLump (&context, lumpnum+ML_SSECTORS);
+    HashLump (&context, lumpnum+ML_NODES);
+
+    // The reject and blockmap can be large: stand in the size
+    //  and time of the file they come from for their contents.
+    W_ChecksumLumpFile (&context, lumpnum+ML_REJECT);
+    W_ChecksumLumpFile (&context, lumpnum+ML_BLOCKMAP);
+
+    SHA1_Final (digest, &context);
+    memcpy (levelcache_key, digest, sizeof(digest));
+
+    for (i=0 ; i<sizeof(digest) ; i++)
+    {
+	name[i*2] = hex[digest[i] >> 4];
+	name[i*2+1] = hex[digest[i] & 15];
+    }
+
+    M_StringCopy (name + sizeof(digest) * 2, ".lvl", 5);
+
+    dir = M_StringJoin (configdir, "levelcache", NULL);
+    M_MakeDirectory (dir);
+
+    result = M_StringJoin (dir, DIR_SEPARATOR_S, name, NULL);
+    free (dir);
+
+    return result;
+}
+
+
+
+// True if count elements of the given size at ofs lie inside
+//  the file, after the header and aligned for pointers.
+
+static boolean CheckArray (levelcache_t *cache, int ofs, int count, int size)
+{
+    return ofs >= (int) sizeof(levelcache_t)
+	&& ofs % sizeof(void *) == 0
+	&& count >= 0
+	&& count <= (cache->length - ofs) / size;
+}
+
+//
+// P_ReadLevelCache
+// Returns the cache of the map at lumpnum in a PU_LEVEL block,
+//  or NULL if there is none.
+//
+void *P_ReadLevelCache (int lumpnum)
+{
+    levelcache_t	*cache;
+    FILE		*handle;
+    long		length;
+
+    if (!levelcache_enabled)
+	return NULL;
+
+    if (levelcache_file != NULL)
+	free (levelcache_file);
+
+    levelcache_file = LevelCacheName (lumpnum);
+    handle = fopen (levelcache_file, "rb");
+
+    if (handle == NULL)
+	return NULL;
+
+    length = M_FileLength (handle);
+
+    if (length < (long) sizeof(levelcache_t))
+    {
+	fclose (handle);
+	return NULL;
+    }
+
+    cache = Z_Malloc (length, PU_LEVEL, NULL);
+
+    if (fread (cache, 1, length, handle) != (size_t) length
+     || memcmp (cache->magic, levelcache_magic, sizeof(cache->magic))
+     || memcmp (cache->key, levelcache_key, sizeof(cache->key))
+     || cache->length != length
+     || !CheckArray (cache, cache->linesofs, cache->numlines, sizeof(line_t))
+     || !CheckArray (cache, cache->segsofs, cache->numsegs, sizeof(seg_t))
+     || !CheckArray (cache, cache->linebufferofs, cache->totallines,
+		     sizeof(line_t *))
+     || !CheckArray (cache, cache->sectorsofs, cache->numsectors,
+		     sizeof(cachedsector_t))
+     || !CheckArray (cache, cache->subsectorsofs, cache->numsubsectors,
+		     sizeof(int))
+     || !CheckArray (cache, cache->blockmapofs, cache->blockmaplen,
+		     sizeof(int32_t))
+     || !CheckArray (cache, cache->rejectofs, cache->rejectlen, 1))
+    {
+	fclose (handle);
+	Z_Free (cache);
+	return NULL;
+    }
+
+    fclose (handle);
+
+    return cache;
+}
+
+
+
+// True if an encoded pointer is NULL or inside an array of count.
+#define INRANGE(p, count)	((uintptr_t) (p) <= (uintptr_t) (count))
+
+//
+// CheckIndices
+// True if every pointer in the cache points into the level.
+//
+static boolean CheckIndices (levelcache_t *cache)
+{
+    byte		*base;
+    cachedsector_t	*cs;
+    line_t		**linebuffer;
+    line_t		*li;
+    seg_t		*seg;
+    int			*ss;
+    int			i;
+
+    base = (byte *) cache;
+
+    li = (line_t *) (base + cache->linesofs);
+
+    for (i=0 ; i<cache->numlines ; i++, li++)
+    {
+	if (!INRANGE (li->v1, numvertexes)
+	 || !INRANGE (li->v2, numvertexes)
+	 || !INRANGE (li->frontsector, numsectors)
+	 || !INRANGE (li->backsector, numsectors))
+	    return false;
+    }
+
+    seg = (seg_t *) (base + cache->segsofs);
+
+    for (i=0 ; i<cache->numsegs ; i++, seg++)
+    {
+	if (!INRANGE (seg->v1, numvertexes)
+	 || !INRANGE (seg->v2, numvertexes)
+	 || !INRANGE (seg->sidedef, numsides)
+	 || !INRANGE (seg->linedef, cache->numlines)
+	 || !INRANGE (seg->frontsector, numsectors)
+	 || (seg->backsector != NULLSECTOR
+	  && !INRANGE (seg->backsector, numsectors)))
+	    return false;
+    }
+
+    linebuffer = (line_t **) (base + cache->linebufferofs);
+
+    for (i=0 ; i<cache->totallines ; i++)
+    {
+	if (!INRANGE (linebuffer[i], cache->numlines))
+	    return false;
+    }
+
+    cs = (cachedsector_t *) (base + cache->sectorsofs);
+
+    for (i=0 ; i<numsectors ; i++, cs++)
+    {
+	if (cs->lines < 0
+	 || cs->linecount < 0
+	 || cs->linecount > cache->totallines - cs->lines)
+	    return false;
+    }
+
+    ss = (int *) (base + cache->subsectorsofs);
+
+    for (i=0 ; i<numsubsectors ; i++)
+    {
+	if (ss[i] < 0 || ss[i] >= numsectors
+	 || subsectors[i].firstline < 0
+	 || subsectors[i].numlines < 0
+	 || subsectors[i].numlines > cache->numsegs - subsectors[i].firstline)
+	    return false;
+    }
+
+    // P_LoadReject pads a short lump to this.
+    if (cache->rejectlen < (numsectors * numsectors + 7) / 8)
+	return false;
+
+    return true;
+}
+
+//
+// P_RelocateLevelCache
+// Sets up lines, segs, sector line lists, subsector sectors,
+//  blockmap and reject from a cache returned by P_ReadLevelCache.
+// Vertexes, sectors and sides must already be loaded, as well
+//  as subsectors.
+// Returns false, with the cache left as it was, if it does not
+//  fit the level.
+//
+boolean P_RelocateLevelCache (void *data)
+{
+    levelcache_t	*cache;
+    byte		*base;
+    cachedsector_t	*cs;
+    line_t		**linebuffer;
+    line_t		*li;
+    seg_t		*seg;
+    int			*ss;
+    int			count;
+    int			i;
+
+    cache = data;
+    base = data;
+
+    if (cache->numvertexes != numvertexes
+     || cache->numsectors != numsectors
+     || cache->numsides != numsides
+     || cache->numsubsectors != numsubsectors
+     || !CheckIndices (cache))
+    {
+	return false;
+    }
+
+    blockmaplump = (int32_t *) (base + cache->blockmapofs);
+    blockmaplen = cache->blockmaplen;
+
+    if (blockmaplen < 4)
+	return false;
+
+    blockmap = blockmaplump + 4;
+    bmaporgx = blockmaplump[0]<<FRACBITS;
+    bmaporgy = blockmaplump[1]<<FRACBITS;
+    bmapwidth = blockmaplump[2];
+    bmapheight = blockmaplump[3];
+
+    if (!P_CheckBlockMap ())
+	return false;
+
+    numlines = cache->numlines;
+    lines = (line_t *) (base + cache->linesofs);
+
+    for (i=0, li=lines ; i<numlines ; i++, li++)
+    {
+	li->v1 = DECODE (li->v1, vertexes);
+	li->v2 = DECODE (li->v2, vertexes);
+	li->frontsector = DECODE (li->frontsector, sectors);
+	li->backsector = DECODE (li->backsector, sectors);
+    }
+
+    numsegs = cache->numsegs;
+    segs = (seg_t *) (base + cache->segsofs);
+
+    for (i=0, seg=segs ; i<numsegs ; i++, seg++)
+    {
+	seg->v1 = DECODE (seg->v1, vertexes);
+	seg->v2 = DECODE (seg->v2, vertexes);
+	seg->sidedef = DECODE (seg->sidedef, sides);
+	seg->linedef = DECODE (seg->linedef, lines);
+	seg->frontsector = DECODE (seg->frontsector, sectors);
+
+	if (seg->backsector == NULLSECTOR)
+	    seg->backsector = GetSectorAtNullAddress ();
+	else
+	    seg->backsector = DECODE (seg->backsector, sectors);
+    }
+
+    linebuffer = (line_t **) (base + cache->linebufferofs);
+
+    for (i=0 ; i<cache->totallines ; i++)
+	linebuffer[i] = DECODE (linebuffer[i], lines);
+
+    cs = (cachedsector_t *) (base + cache->sectorsofs);
+
+    for (i=0 ; i<numsectors ; i++, cs++)
+    {
+	sectors[i].linecount = cs->linecount;
+	sectors[i].lines = linebuffer + cs->lines;
+	memcpy (sectors[i].blockbox, cs->blockbox, sizeof(cs->blockbox));
+	sectors[i].soundorg.x = cs->soundorgx;
+	sectors[i].soundorg.y = cs->soundorgy;
+    }
+
+    ss = (int *) (base + cache->subsectorsofs);
+
+    for (i=0 ; i<numsubsectors ; i++)
+	subsectors[i].sector = &sectors[ss[i]];
+
+    count = sizeof(*blocklinks) * bmapwidth * bmapheight;
+    blocklinks = Z_Malloc (count, PU_LEVEL, 0);
+    memset (blocklinks, 0, count);
+
+    rejectmatrix = base + cache->rejectofs;
+
+    return true;
+}
+
+
+
+//
+// P_WriteLevelCache
+// Called by P_SetupLevel once the level geometry is built and
+//  before anything has been spawned into it, after a
+//  P_ReadLevelCache that found nothing.
+//
+void P_WriteLevelCache (int lumpnum)
+{
+    levelcache_t	*cache;
+    byte		*base;
+    cachedsector_t	*cs;
+    line_t		**linebuffer;
+    line_t		*li;
+    seg_t		*seg;
+    int			*ss;
+    int			length;
+    int			totallines;
+    int			rejectlen;
+    int			i;
+
+    if (!levelcache_enabled || levelcache_file == NULL)
+	return;
+
+    totallines = 0;
+
+    for (i=0 ; i<numsectors ; i++)
+	totallines += sectors[i].linecount;
+
+    // P_LoadReject pads a short lump to this.
+    rejectlen = (numsectors * numsectors + 7) / 8;
+
+    if (W_LumpLength (lumpnum+ML_REJECT) > rejectlen)
+	rejectlen = W_LumpLength (lumpnum+ML_REJECT);
+
+    // Lay the file out, keeping every array pointer aligned.
+
+#define ALIGNED(n)	(((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+    length = ALIGNED (sizeof(levelcache_t));
+
+    cache = Z_Malloc (sizeof(*cache), PU_STATIC, NULL);
+    memset (cache, 0, sizeof(*cache));
+    memcpy (cache->magic, levelcache_magic, sizeof(cache->magic));
+    memcpy (cache->key, levelcache_key, sizeof(cache->key));
+
+    cache->numvertexes = numvertexes;
+    cache->numsectors = numsectors;
+    cache->numsides = numsides;
+    cache->numlines = numlines;
+    cache->numsegs = numsegs;
+    cache->numsubsectors = numsubsectors;
+    cache->totallines = totallines;
+    cache->blockmaplen = blockmaplen;
+    cache->rejectlen = rejectlen;
+
+    cache->linesofs = length;
+    length = ALIGNED (length + numlines * sizeof(line_t));
+    cache->segsofs = length;
+    length = ALIGNED (length + numsegs * sizeof(seg_t));
+    cache->linebufferofs = length;
+    length = ALIGNED (length + totallines * sizeof(line_t *));
+    cache->sectorsofs = length;
+    length = ALIGNED (length + numsectors * sizeof(cachedsector_t));
+    cache->subsectorsofs = length;
+    length = ALIGNED (length + numsubsectors * sizeof(int));
+    cache->blockmapofs = length;
+    length = ALIGNED (length + blockmaplen * sizeof(int32_t));
+    cache->rejectofs = length;
+    length = ALIGNED (length + rejectlen);
+    cache->length = length;
+
+#undef ALIGNED
+
+    base = Z_Malloc (length, PU_STATIC, NULL);
+    memset (base, 0, length);
+    memcpy (base, cache, sizeof(*cache));
+    Z_Free (cache);
+    cache = (levelcache_t *) base;
+
+    li = (line_t *) (base + cache->linesofs);
+    memcpy (li, lines, numlines * sizeof(line_t));
+
+    for (i=0 ; i<numlines ; i++, li++)
+    {
+	li->v1 = ENCODE (li->v1, vertexes);
+	li->v2 = ENCODE (li->v2, vertexes);
+	li->frontsector = ENCODE (li->frontsector, sectors);
+	li->backsector = ENCODE (li->backsector, sectors);
+    }
+
+    seg = (seg_t *) (base + cache->segsofs);
+    memcpy (seg, segs, numsegs * sizeof(seg_t));
+
+    for (i=0 ; i<numsegs ; i++, seg++)
+    {
+	seg->v1 = ENCODE (seg->v1, vertexes);
+	seg->v2 = ENCODE (seg->v2, vertexes);
+	seg->sidedef = ENCODE (seg->sidedef, sides);
+	seg->linedef = ENCODE (seg->linedef, lines);
+	seg->frontsector = ENCODE (seg->frontsector, sectors);
+
+	if (seg->backsector == GetSectorAtNullAddress ())
+	    seg->backsector = NULLSECTOR;
+	else
+	    seg->backsector = ENCODE (seg->backsector, sectors);
+    }
+
+    // P_GroupLines puts the sector line lists back to back in
+    //  one buffer, starting with the first sector's.
+
+    linebuffer = (line_t **) (base + cache->linebufferofs);
+    cs = (cachedsector_t *) (base + cache->sectorsofs);
+
+    for (i=0 ; i<numsectors ; i++, cs++)
+    {
+	cs->linecount = sectors[i].linecount;
+	cs->lines = sectors[i].lines - sectors[0].lines;
+	memcpy (cs->blockbox, sectors[i].blockbox, sizeof(cs->blockbox));
+	cs->soundorgx = sectors[i].soundorg.x;
+	cs->soundorgy = sectors[i].soundorg.y;
+    }
+
+    for (i=0 ; i<totallines ; i++)
+	linebuffer[i] = ENCODE (sectors[0].lines[i], lines);
+
+    ss = (int *) (base + cache->subsectorsofs);
+
+    for (i=0 ; i<numsubsectors ; i++)
+	ss[i] = subsectors[i].sector - sectors;
+
+    memcpy (base + cache->blockmapofs, blockmaplump, blockmaplen * sizeof(int32_t));
+    memcpy (base + cache->rejectofs, rejectmatrix, rejectlen);
+
+    M_WriteFile (levelcache_file, base, length);
+
+    Z_Free (base);
+}
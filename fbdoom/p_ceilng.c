@@ -17,6 +17,8 @@
 
 
 
+#include <string.h>
+
 #include "z_zone.h"
 #include "doomdef.h"
 #include "p_local.h"
@@ -35,7 +37,9 @@
 //
 
 
-ceiling_t*	activeceilings[MAXCEILINGS];
+ceiling_t**	activeceilings;
+int		numactiveceilings;
+static int	maxactiveceilings;
 
 
 //
@@ -189,7 +193,7 @@ EV_DoCeiling
 	
 	// new door thinker
 	rtn = 1;
-	ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVSPEC, 0);
+	ceiling = Z_PoolAlloc (&ceilingpool);
 	P_AddThinker (&ceiling->thinker);
 	sec->specialdata = ceiling;
 	ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
@@ -236,19 +240,41 @@ EV_DoCeiling
 
 //
 // Add an active ceiling
+// The active ceilings are kept packed at the start of
+// activeceilings, each knowing its own index, so adding and
+// removing one is constant time.
+//
+// Vanilla silently left a ceiling off a full list, and such
+// a ceiling could never be stopped or removed again; keep
+// doing that when the overruns are emulated.
 //
 void P_AddActiveCeiling(ceiling_t* c)
 {
-    int		i;
-    
-    for (i = 0; i < MAXCEILINGS;i++)
+    ceiling_t**	newceilings;
+
+    if (numactiveceilings >= MAXCEILINGS && P_VanillaOverruns ())
     {
-	if (activeceilings[i] == NULL)
+	c->activeindex = -1;
+	return;
+    }
+
+    if (numactiveceilings == maxactiveceilings)
+    {
+	maxactiveceilings = maxactiveceilings ? maxactiveceilings*2 : MAXCEILINGS;
+	newceilings = Z_Malloc (maxactiveceilings*sizeof(*newceilings), PU_STATIC, 0);
+
+	if (activeceilings)
 	{
-	    activeceilings[i] = c;
-	    return;
+	    memcpy (newceilings, activeceilings,
+		    numactiveceilings*sizeof(*newceilings));
+	    Z_Free (activeceilings);
 	}
+
+	activeceilings = newceilings;
     }
+
+    c->activeindex = numactiveceilings;
+    activeceilings[numactiveceilings++] = c;
 }
 
 
@@ -259,17 +285,18 @@ void P_AddActiveCeiling(ceiling_t* c)
 void P_RemoveActiveCeiling(ceiling_t* c)
 {
     int		i;
-	
-    for (i = 0;i < MAXCEILINGS;i++)
-    {
-	if (activeceilings[i] == c)
-	{
-	    activeceilings[i]->sector->specialdata = NULL;
-	    P_RemoveThinker (&activeceilings[i]->thinker);
-	    activeceilings[i] = NULL;
-	    break;
-	}
-    }
+
+    i = c->activeindex;
+
+    if (i < 0)
+	return;
+
+    c->sector->specialdata = NULL;
+    P_RemoveThinker (&c->thinker);
+
+    activeceilings[i] = activeceilings[--numactiveceilings];
+    activeceilings[i]->activeindex = i;
+    c->activeindex = -1;
 }
 
 
@@ -281,10 +308,9 @@ void P_ActivateInStasisCeiling(line_t* line)
 {
     int		i;
 	
-    for (i = 0;i < MAXCEILINGS;i++)
+    for (i = 0;i < numactiveceilings;i++)
     {
-	if (activeceilings[i]
-	    && (activeceilings[i]->tag == line->tag)
+	if ((activeceilings[i]->tag == line->tag)
 	    && (activeceilings[i]->direction == 0))
 	{
 	    activeceilings[i]->direction = activeceilings[i]->olddirection;
@@ -306,10 +332,9 @@ int	EV_CeilingCrushStop(line_t	*line)
     int		rtn;
 	
     rtn = 0;
-    for (i = 0;i < MAXCEILINGS;i++)
+    for (i = 0;i < numactiveceilings;i++)
     {
-	if (activeceilings[i]
-	    && (activeceilings[i]->tag == line->tag)
+	if ((activeceilings[i]->tag == line->tag)
 	    && (activeceilings[i]->direction != 0))
 	{
 	    activeceilings[i]->olddirection = activeceilings[i]->direction;
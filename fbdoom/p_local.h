@@ -24,6 +24,8 @@
 #include "r_local.h"
 #endif
 
+#include "z_zone.h"
+
 #define FLOATSPEED		(FRACUNIT*4)
 
 
@@ -63,8 +65,36 @@
 // P_TICK
 //
 
-// both the head and tail of the thinker list
-extern	thinker_t	thinkercap;	
+// One list of thinkers per type, each in the order added.
+// Thinker seq numbers give the order across the lists.
+typedef enum
+{
+    th_mobj,
+    th_ceiling,
+    th_door,
+    th_floor,
+    th_plat,
+    th_flicker,
+    th_flash,
+    th_strobe,
+    th_glow,
+    NUMTHINKERTYPES
+} thinkertype_t;
+
+// both the head and tail of each thinker list
+extern	thinker_t	thinkercaps[NUMTHINKERTYPES];
+
+extern	arena_t		levelarena;
+
+extern	pool_t		mobjpool;
+extern	pool_t		ceilingpool;
+extern	pool_t		doorpool;
+extern	pool_t		floorpool;
+extern	pool_t		platpool;
+extern	pool_t		flickerpool;
+extern	pool_t		flashpool;
+extern	pool_t		strobepool;
+extern	pool_t		glowpool;
 
 
 void P_InitThinkers (void);
@@ -150,11 +180,12 @@ typedef struct
 } intercept_t;
 
 // Extended MAXINTERCEPTS, to allow for intercepts overrun emulation.
+// The list starts at MAXINTERCEPTS and grows as needed.
 
 #define MAXINTERCEPTS_ORIGINAL 128
 #define MAXINTERCEPTS          (MAXINTERCEPTS_ORIGINAL + 61)
 
-extern intercept_t	intercepts[MAXINTERCEPTS];
+extern intercept_t*	intercepts;
 extern intercept_t*	intercept_p;
 
 typedef boolean (*traverser_t) (intercept_t *in);
@@ -176,6 +207,27 @@ void 	P_LineOpening (line_t* linedef);
 boolean P_BlockLinesIterator (int x, int y, boolean(*func)(line_t*) );
 boolean P_BlockThingsIterator (int x, int y, boolean(*func)(mobj_t*) );
 
+// As above, but skip lines whose bounding box misses bbox,
+// and things that are at least range beyond their radius
+// away from (px,py) on either axis.
+boolean
+P_BlockLinesIteratorBox
+( int		x,
+  int		y,
+  fixed_t*	bbox,
+  boolean	(*func)(line_t*) );
+
+boolean
+P_BlockThingsIteratorNear
+( int		x,
+  int		y,
+  fixed_t	px,
+  fixed_t	py,
+  fixed_t	range,
+  boolean	(*func)(mobj_t*) );
+
+void	P_InitBlockArrays (void);
+
 #define PT_ADDLINES		1
 #define PT_ADDTHINGS	2
 #define PT_EARLYOUT		4
@@ -193,6 +245,7 @@ P_PathTraverse
 
 void P_UnsetThingPosition (mobj_t* thing);
 void P_SetThingPosition (mobj_t* thing);
+void P_UpdateBlockThing (mobj_t* thing);
 
 
 //
@@ -215,11 +268,13 @@ extern	line_t*		ceilingline;
 //
 // We keep the original limit, to detect what variables in memory were
 // overwritten (see SpechitOverrun())
+//
+// The list now starts at MAXSPECIALCROSS and grows as needed.
 
 #define MAXSPECIALCROSS 		20
 #define MAXSPECIALCROSS_ORIGINAL	8
 
-extern	line_t*	spechit[MAXSPECIALCROSS];
+extern	line_t**	spechit;
 extern	int	numspechit;
 
 boolean P_CheckPosition (mobj_t *thing, fixed_t x, fixed_t y);
@@ -227,6 +282,8 @@ boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void	P_SlideMove (mobj_t* mo);
 boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void	P_InitSight (void);
+void	P_ClearSightCache (void);
 void 	P_UseLines (player_t* player);
 
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
@@ -259,14 +316,29 @@ P_RadiusAttack
 // P_SETUP
 //
 extern byte*		rejectmatrix;	// for fast sight rejection
-extern short*		blockmaplump;	// offsets in blockmap are from here
-extern short*		blockmap;
+extern int32_t*		blockmaplump;	// offsets in blockmap are from here
+extern int32_t*		blockmap;
+extern int		blockmaplen;	// entries in blockmaplump
 extern int		bmapwidth;
 extern int		bmapheight;	// in mapblocks
 extern fixed_t		bmaporgx;
 extern fixed_t		bmaporgy;	// origin of block map
 extern mobj_t**		blocklinks;	// for thing chains
 
+boolean P_VanillaOverruns (void);
+boolean P_CheckBlockMap (void);
+
+sector_t* GetSectorAtNullAddress(void);
+
+
+//
+// P_CACHE
+//
+void	P_InitLevelCache (void);
+void*	P_ReadLevelCache (int lumpnum);
+boolean	P_RelocateLevelCache (void *cache);
+void	P_WriteLevelCache (int lumpnum);
+
 
 
 //
@@ -19,12 +19,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "deh_misc.h"
 
 #include "m_bbox.h"
 #include "m_random.h"
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "m_argv.h"
@@ -82,8 +84,9 @@ line_t*		ceilingline;
 // keep track of special lines as they are hit,
 // but don't process them until the move is proven valid
 
-line_t*		spechit[MAXSPECIALCROSS];
+line_t**	spechit;
 int		numspechit;
+static int	maxspechit;
 
 
 
@@ -175,7 +178,8 @@ P_TeleportMove
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+	    if (!P_BlockThingsIteratorNear(bx,by,x,y,tmthing->radius,
+					   PIT_StompThing))
 		return false;
     
     // the move is ok,
@@ -199,6 +203,26 @@ P_TeleportMove
 
 static void SpechitOverrun(line_t *ld);
 
+//
+// P_GrowSpecHit
+// Doubles the spechit list, starting from MAXSPECIALCROSS.
+//
+static void P_GrowSpecHit (void)
+{
+    line_t**	newspechit;
+
+    maxspechit = maxspechit ? maxspechit*2 : MAXSPECIALCROSS;
+    newspechit = Z_Malloc (maxspechit*sizeof(*newspechit), PU_STATIC, 0);
+
+    if (spechit)
+    {
+	memcpy (newspechit, spechit, numspechit*sizeof(*newspechit));
+	Z_Free (spechit);
+    }
+
+    spechit = newspechit;
+}
+
 //
 // PIT_CheckLine
 // Adjusts tmfloorz and tmceilingz as lines are contacted
@@ -256,11 +280,14 @@ boolean PIT_CheckLine (line_t* ld)
     // if contacted a special line, add it to the list
     if (ld->special)
     {
+	if (numspechit == maxspechit)
+	    P_GrowSpecHit ();
+
         spechit[numspechit] = ld;
 	numspechit++;
 
         // fraggle: spechits overrun emulation code from prboom-plus
-        if (numspechit > MAXSPECIALCROSS_ORIGINAL)
+        if (numspechit > MAXSPECIALCROSS_ORIGINAL && P_VanillaOverruns ())
         {
             SpechitOverrun(ld);
         }
@@ -451,7 +478,8 @@ P_CheckPosition
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+	    if (!P_BlockThingsIteratorNear(bx,by,x,y,tmthing->radius,
+					   PIT_CheckThing))
 		return false;
     
     // check lines
@@ -462,7 +490,7 @@ P_CheckPosition
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
+	    if (!P_BlockLinesIteratorBox (bx,by,tmbbox,PIT_CheckLine))
 		return false;
 
     return true;
@@ -1276,7 +1304,8 @@ P_RadiusAttack
 	
     for (y=yl ; y<=yh ; y++)
 	for (x=xl ; x<=xh ; x++)
-	    P_BlockThingsIterator (x, y, PIT_RadiusAttack );
+	    P_BlockThingsIteratorNear (x, y, spot->x, spot->y,
+				       damage<<FRACBITS, PIT_RadiusAttack);
 }
 
 
@@ -1320,6 +1349,7 @@ boolean PIT_ChangeSector (mobj_t*	thing)
 	thing->flags &= ~MF_SOLID;
 	thing->height = 0;
 	thing->radius = 0;
+	P_UpdateBlockThing (thing);
 
 	// keep checking
 	return true;		
@@ -1374,6 +1404,9 @@ P_ChangeSector
 	
     nofit = false;
     crushchange = crunch;
+
+    // the heights just changed
+    P_ClearSightCache ();
 	
     // re-check heights for all things near the moving sector
     for (x=sector->blockbox[BOXLEFT] ; x<= sector->blockbox[BOXRIGHT] ; x++)
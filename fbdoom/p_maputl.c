@@ -23,6 +23,7 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "m_bbox.h"
@@ -34,6 +35,7 @@
 
 // State.
 #include "r_state.h"
+#include "z_zone.h"
 
 //
 // P_AproxDistance
@@ -327,6 +329,231 @@ void P_LineOpening (line_t* linedef)
 }
 
 
+//
+// BLOCK ARRAYS
+// Each mapblock also keeps its things and lines in a flat array,
+// so the collision checks walk contiguous memory and can reject
+// most candidates without touching the mobj_t or line_t at all.
+//
+// The blocklinks chains stay authoritative.  A thing array holds
+// its chain in reverse, the head last.  When the original unlink
+// code tangles a chain (a thing unlinked from a different block
+// than the one it was linked into), the blocks involved drop their
+// arrays and are walked along the chain for the rest of the level,
+// so things are always visited in the order demos expect.
+//
+typedef struct
+{
+    mobj_t*	mo;
+    fixed_t	x;
+    fixed_t	y;
+    fixed_t	radius;
+} blockthing_t;
+
+typedef struct
+{
+    blockthing_t*	things;
+    int			count;
+    int			max;	// -1 once the chain is tangled
+} blockthings_t;
+
+typedef struct
+{
+    line_t*	ld;
+    fixed_t	bbox[4];
+} blockline_t;
+
+static blockthings_t*	blockthings;
+static blockline_t*	blocklines;
+static int*		blocklinesstart;	// per block, and one past the end
+
+// Bumped whenever a thing array changes.  An iterator that sees
+// it move under a callback finishes the block along the chain,
+// exactly as the original pointer chasing loop would.
+static unsigned int	blockchanges;
+
+
+//
+// P_InitBlockArrays
+// Called after the blockmap and lines are in place.
+//
+void P_InitBlockArrays (void)
+{
+    int			numblocks;
+    int			total;
+    int			i;
+    int32_t*		list;
+    blockline_t*	bl;
+
+    numblocks = bmapwidth*bmapheight;
+
+    blockthings = Z_Malloc (numblocks*sizeof(*blockthings), PU_LEVEL, 0);
+    memset (blockthings, 0, numblocks*sizeof(*blockthings));
+
+    // Same walk as the original P_BlockLinesIterator,
+    // leading zero entries included.
+    total = 0;
+
+    for (i=0 ; i<numblocks ; i++)
+	for (list = blockmaplump+blockmap[i] ; *list != -1 ; list++)
+	    total++;
+
+    blocklines = Z_Malloc ((total+1)*sizeof(*blocklines), PU_LEVEL, 0);
+    blocklinesstart = Z_Malloc ((numblocks+1)*sizeof(*blocklinesstart),
+				PU_LEVEL, 0);
+    bl = blocklines;
+
+    for (i=0 ; i<numblocks ; i++)
+    {
+	blocklinesstart[i] = bl - blocklines;
+
+	for (list = blockmaplump+blockmap[i] ; *list != -1 ; list++, bl++)
+	{
+	    bl->ld = &lines[*list];
+
+	    if ((unsigned) *list < (unsigned) numlines)
+	    {
+		memcpy (bl->bbox, bl->ld->bbox, sizeof(bl->bbox));
+	    }
+	    else
+	    {
+		// bogus index: never reject it, let the
+		// callback see whatever the original would
+		bl->bbox[BOXTOP] = bl->bbox[BOXRIGHT] = INT_MAX;
+		bl->bbox[BOXBOTTOM] = bl->bbox[BOXLEFT] = INT_MIN;
+	    }
+	}
+    }
+
+    blocklinesstart[numblocks] = bl - blocklines;
+}
+
+
+static void P_TangleBlock (int block)
+{
+    if (block >= 0 && block < bmapwidth*bmapheight)
+    {
+	blockthings[block].max = -1;
+	blockchanges++;
+    }
+}
+
+
+//
+// P_CheckBlockLink
+// In an intact chain all neighbours share a block.  Anything
+// else means a tangled chain is about to be spliced into
+// another one, which cannot be trusted from then on either.
+//
+static void P_CheckBlockLink (mobj_t* thing, mobj_t* other)
+{
+    if (other && other->blockindex != thing->blockindex)
+    {
+	P_TangleBlock (thing->blockindex);
+	P_TangleBlock (other->blockindex);
+    }
+}
+
+
+static void P_AddBlockThing (mobj_t* thing, int block)
+{
+    blockthings_t*	bt;
+    blockthing_t*	things;
+    blockthing_t*	e;
+    int			max;
+
+    bt = &blockthings[block];
+
+    if (bt->max < 0)
+	return;
+
+    if (bt->count == bt->max)
+    {
+	max = bt->max ? bt->max*2 : 4;
+	things = Z_Malloc (max*sizeof(*things), PU_LEVEL, 0);
+
+	if (bt->things)
+	{
+	    memcpy (things, bt->things, bt->count*sizeof(*things));
+	    Z_Free (bt->things);
+	}
+
+	bt->things = things;
+	bt->max = max;
+    }
+
+    e = &bt->things[bt->count++];
+    e->mo = thing;
+    e->x = thing->x;
+    e->y = thing->y;
+    e->radius = thing->radius;
+
+    blockchanges++;
+}
+
+
+static void P_RemoveBlockThing (mobj_t* thing)
+{
+    blockthings_t*	bt;
+    int			i;
+
+    if (thing->blockindex < 0)
+	return;
+
+    bt = &blockthings[thing->blockindex];
+
+    if (bt->max < 0)
+	return;
+
+    for (i=bt->count-1 ; i>=0 ; i--)
+	if (bt->things[i].mo == thing)
+	    break;
+
+    if (i < 0)
+    {
+	// not where it was linked: the chain is off too
+	P_TangleBlock (thing->blockindex);
+	return;
+    }
+
+    memmove (&bt->things[i], &bt->things[i+1],
+	     (bt->count-1-i)*sizeof(*bt->things));
+    bt->count--;
+
+    blockchanges++;
+}
+
+
+//
+// P_UpdateBlockThing
+// Refresh the copy of x, y and radius in the block array
+// after they were changed without relinking the thing.
+//
+void P_UpdateBlockThing (mobj_t* thing)
+{
+    blockthings_t*	bt;
+    blockthing_t*	e;
+    int			i;
+
+    if ((thing->flags & MF_NOBLOCKMAP) || thing->blockindex < 0)
+	return;
+
+    bt = &blockthings[thing->blockindex];
+
+    for (i=bt->count-1, e=bt->things+i ; i>=0 ; i--, e--)
+    {
+	if (e->mo == thing)
+	{
+	    e->x = thing->x;
+	    e->y = thing->y;
+	    e->radius = thing->radius;
+	    return;
+	}
+    }
+}
+
+
+
 //
 // THING POSITION SETTING
 //
@@ -343,6 +570,7 @@ void P_UnsetThingPosition (mobj_t* thing)
 {
     int		blockx;
     int		blocky;
+    int		block;
 
     if ( ! (thing->flags & MF_NOSECTOR) )
     {
@@ -361,6 +589,10 @@ void P_UnsetThingPosition (mobj_t* thing)
     {
 	// inert things don't need to be in blockmap
 	// unlink from block map
+	P_RemoveBlockThing (thing);
+	P_CheckBlockLink (thing, thing->bnext);
+	P_CheckBlockLink (thing, thing->bprev);
+
 	if (thing->bnext)
 	    thing->bnext->bprev = thing->bprev;
 	
@@ -370,11 +602,21 @@ void P_UnsetThingPosition (mobj_t* thing)
 	{
 	    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
 	    blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
+	    block = -1;
 
 	    if (blockx>=0 && blockx < bmapwidth
 		&& blocky>=0 && blocky <bmapheight)
 	    {
-		blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
+		block = blocky*bmapwidth+blockx;
+		blocklinks[block] = thing->bnext;
+	    }
+
+	    // moved without a relink: the head of the block
+	    // it was linked into is left dangling
+	    if (block != thing->blockindex)
+	    {
+		P_TangleBlock (thing->blockindex);
+		P_TangleBlock (block);
 	    }
 	}
     }
@@ -428,18 +670,22 @@ P_SetThingPosition (mobj_t* thing)
 	    && blocky>=0
 	    && blocky < bmapheight)
 	{
-	    link = &blocklinks[blocky*bmapwidth+blockx];
+	    thing->blockindex = blocky*bmapwidth+blockx;
+	    link = &blocklinks[thing->blockindex];
+	    P_CheckBlockLink (thing, *link);
 	    thing->bprev = NULL;
 	    thing->bnext = *link;
 	    if (*link)
 		(*link)->bprev = thing;
 
 	    *link = thing;
+	    P_AddBlockThing (thing, thing->blockindex);
 	}
 	else
 	{
 	    // thing is off the map
 	    thing->bnext = thing->bprev = NULL;
+	    thing->blockindex = -1;
 	}
     }
 }
@@ -470,7 +716,8 @@ P_BlockLinesIterator
   boolean(*func)(line_t*) )
 {
     int			offset;
-    short*		list;
+    blockline_t*	bl;
+    blockline_t*	end;
     line_t*		ld;
 	
     if (x<0
@@ -482,12 +729,67 @@ P_BlockLinesIterator
     }
     
     offset = y*bmapwidth+x;
+
+    bl = blocklines + blocklinesstart[offset];
+    end = blocklines + blocklinesstart[offset+1];
+
+    for ( ; bl < end ; bl++)
+    {
+	ld = bl->ld;
+
+	if (ld->validcount == validcount)
+	    continue; 	// line has already been checked
+
+	ld->validcount = validcount;
+		
+	if ( !func(ld) )
+	    return false;
+    }
+    return true;	// everything was checked
+}
+
+
+//
+// P_BlockLinesIteratorBox
+// Lines whose bounding box misses bbox are passed over
+// without being marked, so they must also be of no interest
+// to func.  Such a line would be passed over again in any
+// other block of the same validcount pass.
+//
+boolean
+P_BlockLinesIteratorBox
+( int			x,
+  int			y,
+  fixed_t*		bbox,
+  boolean(*func)(line_t*) )
+{
+    int			offset;
+    blockline_t*	bl;
+    blockline_t*	end;
+    line_t*		ld;
 	
-    offset = *(blockmap+offset);
+    if (x<0
+	|| y<0
+	|| x>=bmapwidth
+	|| y>=bmapheight)
+    {
+	return true;
+    }
+    
+    offset = y*bmapwidth+x;
 
-    for ( list = blockmaplump+offset ; *list != -1 ; list++)
+    bl = blocklines + blocklinesstart[offset];
+    end = blocklines + blocklinesstart[offset+1];
+
+    for ( ; bl < end ; bl++)
     {
-	ld = &lines[*list];
+	if (bbox[BOXRIGHT] <= bl->bbox[BOXLEFT]
+	    || bbox[BOXLEFT] >= bl->bbox[BOXRIGHT]
+	    || bbox[BOXTOP] <= bl->bbox[BOXBOTTOM]
+	    || bbox[BOXBOTTOM] >= bl->bbox[BOXTOP] )
+	    continue;
+
+	ld = bl->ld;
 
 	if (ld->validcount == validcount)
 	    continue; 	// line has already been checked
@@ -501,6 +803,24 @@ P_BlockLinesIterator
 }
 
 
+//
+// P_BlockThingsChain
+// The original walk along blocklinks.
+//
+static boolean
+P_BlockThingsChain
+( mobj_t*		mobj,
+  boolean(*func)(mobj_t*) )
+{
+    for ( ; mobj ; mobj = mobj->bnext)
+    {
+	if (!func( mobj ) )
+	    return false;
+    }
+    return true;
+}
+
+
 //
 // P_BlockThingsIterator
 //
@@ -510,7 +830,10 @@ P_BlockThingsIterator
   int			y,
   boolean(*func)(mobj_t*) )
 {
+    blockthings_t*	bt;
     mobj_t*		mobj;
+    unsigned int	changes;
+    int			i;
 	
     if ( x<0
 	 || y<0
@@ -519,14 +842,83 @@ P_BlockThingsIterator
     {
 	return true;
     }
-    
 
-    for (mobj = blocklinks[y*bmapwidth+x] ;
-	 mobj ;
-	 mobj = mobj->bnext)
+    bt = &blockthings[y*bmapwidth+x];
+
+    if (bt->max < 0)
+	return P_BlockThingsChain (blocklinks[y*bmapwidth+x], func);
+
+    changes = blockchanges;
+
+    for (i=bt->count-1 ; i>=0 ; i--)
+    {
+	mobj = bt->things[i].mo;
+
+	if (!func( mobj ) )
+	    return false;
+
+	// something was linked or unlinked under us
+	if (blockchanges != changes)
+	    return P_BlockThingsChain (mobj->bnext, func);
+    }
+    return true;
+}
+
+
+//
+// P_BlockThingsIteratorNear
+// Things at least range beyond their radius away from (px,py)
+// on either axis are not passed to func, which must reject
+// them itself without side effects.  The test is written the
+// same way as the ones in PIT_CheckThing and friends.
+//
+boolean
+P_BlockThingsIteratorNear
+( int			x,
+  int			y,
+  fixed_t		px,
+  fixed_t		py,
+  fixed_t		range,
+  boolean(*func)(mobj_t*) )
+{
+    blockthings_t*	bt;
+    blockthing_t*	e;
+    mobj_t*		mobj;
+    unsigned int	changes;
+    int			i;
+	
+    if ( x<0
+	 || y<0
+	 || x>=bmapwidth
+	 || y>=bmapheight)
+    {
+	return true;
+    }
+
+    // A nested search from inside func may have set up other
+    // tm* or bomb* globals; make any outer one fall back.
+    changes = ++blockchanges;
+
+    bt = &blockthings[y*bmapwidth+x];
+
+    if (bt->max < 0)
+	return P_BlockThingsChain (blocklinks[y*bmapwidth+x], func);
+
+    for (i=bt->count-1 ; i>=0 ; i--)
     {
+	e = &bt->things[i];
+
+	if (abs(e->x - px) >= e->radius + range
+	    || abs(e->y - py) >= e->radius + range)
+	    continue;
+
+	mobj = e->mo;
+
 	if (!func( mobj ) )
 	    return false;
+
+	if (blockchanges != changes)
+	    return P_BlockThingsChain (mobj->bnext, func);
     }
     return true;
 }
@@ -536,8 +928,10 @@ P_BlockThingsIterator
 //
 // INTERCEPT ROUTINES
 //
-intercept_t	intercepts[MAXINTERCEPTS];
+intercept_t*	intercepts;
 intercept_t*	intercept_p;
+static int	maxintercepts;
+static int*	interceptorder;	// sorted by P_TraverseIntercepts
 
 divline_t 	trace;
 boolean 	earlyout;
@@ -545,6 +939,35 @@ int		ptflags;
 
 static void InterceptsOverrun(int num_intercepts, intercept_t *intercept);
 
+
+//
+// P_GrowIntercepts
+// Doubles the intercepts list, starting from the vanilla
+// size plus the overrun emulation slack.  intercept_p is
+// moved along with the list.
+//
+static void P_GrowIntercepts (void)
+{
+    intercept_t*	newintercepts;
+    int			count;
+
+    count = intercept_p - intercepts;
+    maxintercepts = maxintercepts ? maxintercepts*2 : MAXINTERCEPTS;
+
+    newintercepts = Z_Malloc (maxintercepts*sizeof(*newintercepts), PU_STATIC, 0);
+
+    if (intercepts)
+    {
+	memcpy (newintercepts, intercepts, count*sizeof(*newintercepts));
+	Z_Free (intercepts);
+	Z_Free (interceptorder);
+    }
+
+    interceptorder = Z_Malloc (maxintercepts*sizeof(*interceptorder), PU_STATIC, 0);
+    intercepts = newintercepts;
+    intercept_p = intercepts + count;
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -597,6 +1020,9 @@ PIT_AddLineIntercepts (line_t* ld)
     }
     
 	
+    if (intercept_p == intercepts + maxintercepts)
+	P_GrowIntercepts ();
+
     intercept_p->frac = frac;
     intercept_p->isaline = true;
     intercept_p->d.line = ld;
@@ -663,6 +1089,9 @@ boolean PIT_AddThingIntercepts (mobj_t* thing)
     if (frac < 0)
 	return true;		// behind source
 
+    if (intercept_p == intercepts + maxintercepts)
+	P_GrowIntercepts ();
+
     intercept_p->frac = frac;
     intercept_p->isaline = false;
     intercept_p->d.thing = thing;
@@ -674,23 +1103,23 @@ boolean PIT_AddThingIntercepts (mobj_t* thing)
 
 
 //
-// P_TraverseIntercepts
-// Returns true if the traverser function returns true
-// for all lines.
-// 
-boolean
-P_TraverseIntercepts
+// P_ScanIntercepts
+// The original traversal: rescan the list for the nearest
+// intercept at every step, lowest index first among equals.
+// last is the index of the last intercept visited, which the
+// original would pass again if nothing is left below INT_MAX.
+// func may trace another line and move the list, so only
+// indexes are kept across the call.
+//
+static boolean
+P_ScanIntercepts
 ( traverser_t	func,
-  fixed_t	maxfrac )
+  fixed_t	maxfrac,
+  int		count,
+  int		last )
 {
-    int			count;
     fixed_t		dist;
     intercept_t*	scan;
-    intercept_t*	in;
-	
-    count = intercept_p - intercepts;
-    
-    in = 0;			// shut up compiler warning
 	
     while (count--)
     {
@@ -700,32 +1129,88 @@ P_TraverseIntercepts
 	    if (scan->frac < dist)
 	    {
 		dist = scan->frac;
-		in = scan;
+		last = scan - intercepts;
 	    }
 	}
 	
 	if (dist > maxfrac)
 	    return true;	// checked everything in range		
 
-#if 0  // UNUSED
+        if ( !func (&intercepts[last]) )
+	    return false;	// don't bother going farther
+
+	intercepts[last].frac = INT_MAX;
+    }
+	
+    return true;		// everything was traversed
+}
+
+
+//
+// P_TraverseIntercepts
+// Returns true if the traverser function returns true
+// for all lines.
+//
+// Rather than rescanning for the nearest intercept at every
+// step, sort an index by frac once.  The insertion sort is
+// stable, so equal fracs keep the order they were added in,
+// as with the scan; and the intercepts are mostly added in
+// order along the trace already.
+// 
+static int		traversals;	// bumped by P_PathTraverse
+
+boolean
+P_TraverseIntercepts
+( traverser_t	func,
+  fixed_t	maxfrac )
+{
+    int			count;
+    int			i;
+    int			j;
+    int			pass;
+    int			last;
+    fixed_t		frac;
+	
+    count = intercept_p - intercepts;
+
+    last = 0;			// shut up compiler warning
+
+    for (i=0 ; i<count ; i++)
     {
-	// don't check these yet, there may be others inserted
-	in = scan = intercepts;
-	for ( scan = intercepts ; scan<intercept_p ; scan++)
-	    if (scan->frac > maxfrac)
-		*in++ = *scan;
-	intercept_p = in;
-	return false;
+	frac = intercepts[i].frac;
+
+	for (j=i ; j>0 && intercepts[interceptorder[j-1]].frac > frac ; j--)
+	    interceptorder[j] = interceptorder[j-1];
+
+	interceptorder[j] = i;
     }
-#endif
 
-        if ( !func (in) )
+    pass = traversals;
+
+    for (i=0 ; i<count ; i++)
+    {
+	// Nothing left but INT_MAX: let the scan
+	// decide what happens, as it always did.
+	if (intercepts[interceptorder[i]].frac == INT_MAX)
+	    break;
+
+	last = interceptorder[i];
+
+	if (intercepts[last].frac > maxfrac)
+	    return true;	// checked everything in range		
+
+        if ( !func (&intercepts[last]) )
 	    return false;	// don't bother going farther
 
-	in->frac = INT_MAX;
+	intercepts[last].frac = INT_MAX;
+
+	// func traced another line and reused the list;
+	// continue the way the scan would have
+	if (traversals != pass)
+	    return P_ScanIntercepts (func, maxfrac, count-i-1, last);
     }
 	
-    return true;		// everything was traversed
+    return P_ScanIntercepts (func, maxfrac, count-i, last);
 }
 
 extern fixed_t bulletslope;
@@ -828,7 +1313,7 @@ static void InterceptsOverrun(int num_intercepts, intercept_t *intercept)
 {
     int location;
 
-    if (num_intercepts <= MAXINTERCEPTS_ORIGINAL)
+    if (num_intercepts <= MAXINTERCEPTS_ORIGINAL || !P_VanillaOverruns ())
     {
         // No overrun
 
@@ -891,6 +1376,7 @@ P_PathTraverse
 		
     validcount++;
     intercept_p = intercepts;
+    traversals++;
 	
     if ( ((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0)
 	x1 += FRACUNIT;	// don't side exactly on a line
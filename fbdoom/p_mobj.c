@@ -513,7 +513,7 @@ P_SpawnMobj
     state_t*	st;
     mobjinfo_t*	info;
 	
-    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+    mobj = Z_PoolAlloc (&mobjpool);
     memset (mobj, 0, sizeof (*mobj));
     info = &mobjinfo[type];
 	
@@ -914,6 +914,7 @@ void P_CheckMissileSpawn (mobj_t* th)
     // be computed if it immediately explodes
     th->x += (th->momx>>1);
     th->y += (th->momy>>1);
+    P_UpdateBlockThing (th);
     th->z += (th->momz>>1);
 
     if (!P_TryMove (th, th->x, th->y))
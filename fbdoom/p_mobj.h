@@ -198,6 +198,24 @@ typedef enum
 
 
 // Map Object definition.
+//
+// The fields are ordered by how often the play simulation and
+// the renderer touch them.  What P_MobjThinker, the movement code
+// and the blockmap callbacks read every tic, from x to player,
+// comes first and ends within the first 128 bytes on 32 and 64
+// bit builds alike.  The drawing fields and the block and sector
+// links follow; on 64 bit builds most of them fall past those
+// 128 bytes.  What only the action functions, respawning and
+// savegames use is at the end.
+// Savegames are written field by field (see p_saveg.c), so the
+// order here does not matter to them.
+//
+// This leaves less padding than the vanilla order, but timing
+// P_RunThinkers over thousands of moving things shows no
+// difference between the two beyond noise.
+//
+// x, y and z must follow the thinker: sound origins are
+// degenmobj_t cast to mobj_t.
 typedef struct mobj_s
 {
     // List: thinker links.
@@ -208,21 +226,10 @@ typedef struct mobj_s
     fixed_t		y;
     fixed_t		z;
 
-    // More list: links in sector (if needed)
-    struct mobj_s*	snext;
-    struct mobj_s*	sprev;
-
-    //More drawing info: to determine current sprite.
-    angle_t		angle;	// orientation
-    spritenum_t		sprite;	// used to find patch_t and flip value
-    int			frame;	// might be ORed with FF_FULLBRIGHT
-
-    // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*	bnext;
-    struct mobj_s*	bprev;
-    
-    struct subsector_s*	subsector;
+    // Momentums, used to update position.
+    fixed_t		momx;
+    fixed_t		momy;
+    fixed_t		momz;
 
     // The closest interval over all contacted Sectors.
     fixed_t		floorz;
@@ -232,30 +239,48 @@ typedef struct mobj_s
     fixed_t		radius;
     fixed_t		height;	
 
-    // Momentums, used to update position.
-    fixed_t		momx;
-    fixed_t		momy;
-    fixed_t		momz;
+    int			flags;
+    int			tics;	// state tic counter
+    state_t*		state;
 
-    // If == validcount, already checked.
-    int			validcount;
+    struct subsector_s*	subsector;
 
     mobjtype_t		type;
-    mobjinfo_t*		info;	// &mobjinfo[mobj->type]
-    
-    int			tics;	// state tic counter
-    state_t*		state;
-    int			flags;
     int			health;
+    mobjinfo_t*		info;	// &mobjinfo[mobj->type]
 
-    // Movement direction, movement generation (zig-zagging).
-    int			movedir;	// 0-7
-    int			movecount;	// when 0, select a new dir
+    // Additional info record for player avatars only.
+    // Only valid if type == MT_PLAYER
+    struct player_s*	player;
+
+    //More drawing info: to determine current sprite.
+    angle_t		angle;	// orientation
+    spritenum_t		sprite;	// used to find patch_t and flip value
+    int			frame;	// might be ORed with FF_FULLBRIGHT
+
+    // Interaction info, by BLOCKMAP.
+    // Links in blocks (if needed).
+    int			blockindex;	// block whose thing array holds it
+    struct mobj_s*	bnext;
+    struct mobj_s*	bprev;
+
+    // More list: links in sector (if needed)
+    struct mobj_s*	snext;
+    struct mobj_s*	sprev;
+
+    // Cold from here on.
 
     // Thing being chased/attacked (or NULL),
     // also the originator for missiles.
     struct mobj_s*	target;
 
+    // Thing being chased/attacked for tracers.
+    struct mobj_s*	tracer;	
+
+    // Movement direction, movement generation (zig-zagging).
+    int			movedir;	// 0-7
+    int			movecount;	// when 0, select a new dir
+
     // Reaction time: if non 0, don't attack yet.
     // Used by player to freeze a bit after teleporting.
     int			reactiontime;   
@@ -264,18 +289,14 @@ typedef struct mobj_s
     // no matter what (even if shot)
     int			threshold;
 
-    // Additional info record for player avatars only.
-    // Only valid if type == MT_PLAYER
-    struct player_s*	player;
-
     // Player number last looked for.
     int			lastlook;	
 
+    // If == validcount, already checked.
+    int			validcount;
+
     // For nightmare respawn.
     mapthing_t		spawnpoint;	
-
-    // Thing being chased/attacked for tracers.
-    struct mobj_s*	tracer;	
     
 } mobj_t;
 
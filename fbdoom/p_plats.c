@@ -17,6 +17,7 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 
 #include "i_system.h"
 #include "z_zone.h"
@@ -35,7 +36,9 @@
 #include "sounds.h"
 
 
-plat_t*		activeplats[MAXPLATS];
+plat_t**	activeplats;
+int		numactiveplats;
+static int	maxactiveplats;
 
 
 
@@ -160,7 +163,7 @@ EV_DoPlat
 	
 	// Find lowest & highest floors around sector
 	rtn = 1;
-	plat = Z_Malloc( sizeof(*plat), PU_LEVSPEC, 0);
+	plat = Z_PoolAlloc (&platpool);
 	P_AddThinker(&plat->thinker);
 		
 	plat->type = type;
@@ -249,9 +252,8 @@ void P_ActivateInStasis(int tag)
 {
     int		i;
 	
-    for (i = 0;i < MAXPLATS;i++)
-	if (activeplats[i]
-	    && (activeplats[i])->tag == tag
+    for (i = 0;i < numactiveplats;i++)
+	if ((activeplats[i])->tag == tag
 	    && (activeplats[i])->status == in_stasis)
 	{
 	    (activeplats[i])->status = (activeplats[i])->oldstatus;
@@ -264,9 +266,8 @@ void EV_StopPlat(line_t* line)
 {
     int		j;
 	
-    for (j = 0;j < MAXPLATS;j++)
-	if (activeplats[j]
-	    && ((activeplats[j])->status != in_stasis)
+    for (j = 0;j < numactiveplats;j++)
+	if (((activeplats[j])->status != in_stasis)
 	    && ((activeplats[j])->tag == line->tag))
 	{
 	    (activeplats[j])->oldstatus = (activeplats[j])->status;
@@ -275,30 +276,47 @@ void EV_StopPlat(line_t* line)
 	}
 }
 
+//
+// The active plats are kept packed at the start of activeplats,
+// each knowing its own index, so adding and removing one is
+// constant time.  Only ever searched by tag for every match, so
+// the order they end up in does not matter.
+//
 void P_AddActivePlat(plat_t* plat)
 {
-    int		i;
-    
-    for (i = 0;i < MAXPLATS;i++)
-	if (activeplats[i] == NULL)
+    plat_t**	newplats;
+
+    if (numactiveplats == maxactiveplats)
+    {
+	maxactiveplats = maxactiveplats ? maxactiveplats*2 : MAXPLATS;
+	newplats = Z_Malloc (maxactiveplats*sizeof(*newplats), PU_STATIC, 0);
+
+	if (activeplats)
 	{
-	    activeplats[i] = plat;
-	    return;
+	    memcpy (newplats, activeplats, numactiveplats*sizeof(*newplats));
+	    Z_Free (activeplats);
 	}
-    I_Error ("P_AddActivePlat: no more plats!");
+
+	activeplats = newplats;
+    }
+
+    plat->activeindex = numactiveplats;
+    activeplats[numactiveplats++] = plat;
 }
 
 void P_RemoveActivePlat(plat_t* plat)
 {
     int		i;
-    for (i = 0;i < MAXPLATS;i++)
-	if (plat == activeplats[i])
-	{
-	    (activeplats[i])->sector->specialdata = NULL;
-	    P_RemoveThinker(&(activeplats[i])->thinker);
-	    activeplats[i] = NULL;
-	    
-	    return;
-	}
-    I_Error ("P_RemoveActivePlat: can't find plat!");
+
+    i = plat->activeindex;
+
+    if (i < 0 || i >= numactiveplats || activeplats[i] != plat)
+	I_Error ("P_RemoveActivePlat: can't find plat!");
+
+    plat->sector->specialdata = NULL;
+    P_RemoveThinker(&plat->thinker);
+
+    activeplats[i] = activeplats[--numactiveplats];
+    activeplats[i]->activeindex = i;
+    plat->activeindex = -1;
 }
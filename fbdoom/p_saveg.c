@@ -1594,7 +1594,9 @@ void P_ArchiveThinkers (void)
     thinker_t*		th;
 
     // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    for (th = thinkercaps[th_mobj].next ;
+	 th != &thinkercaps[th_mobj] ;
+	 th = th->next)
     {
 	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 	{
@@ -1623,19 +1625,23 @@ void P_UnArchiveThinkers (void)
     thinker_t*		currentthinker;
     thinker_t*		next;
     mobj_t*		mobj;
+    int			i;
     
     // remove all the current thinkers
-    currentthinker = thinkercap.next;
-    while (currentthinker != &thinkercap)
+    for (i=0 ; i<NUMTHINKERTYPES ; i++)
     {
-	next = currentthinker->next;
+	currentthinker = thinkercaps[i].next;
+	while (currentthinker != &thinkercaps[i])
+	{
+	    next = currentthinker->next;
 	
-	if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
-	    P_RemoveMobj ((mobj_t *)currentthinker);
-	else
-	    Z_Free (currentthinker);
+	    if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+		P_RemoveMobj ((mobj_t *)currentthinker);
+	    else
+		Z_PoolFree (currentthinker);
 
-	currentthinker = next;
+	    currentthinker = next;
+	}
     }
     P_InitThinkers ();
     
@@ -1650,7 +1656,7 @@ void P_UnArchiveThinkers (void)
 			
 	  case tc_mobj:
 	    saveg_read_pad();
-	    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+	    mobj = Z_PoolAlloc (&mobjpool);
             saveg_read_mobj_t(mobj);
 
 	    mobj->target = NULL;
@@ -1703,19 +1709,38 @@ enum
 //
 void P_ArchiveSpecials (void)
 {
+    thinker_t*		next[NUMTHINKERTYPES];
     thinker_t*		th;
+    int			type;
     int			i;
 	
-    // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    for (i=0 ; i<NUMTHINKERTYPES ; i++)
+	next[i] = thinkercaps[i].next;
+
+    // save off the current thinkers,
+    // in the order they were added
+    while (1)
     {
+	type = -1;
+
+	for (i=th_mobj+1 ; i<NUMTHINKERTYPES ; i++)
+	{
+	    if (next[i] != &thinkercaps[i]
+		&& (type < 0 || next[i]->seq < next[type]->seq))
+		type = i;
+	}
+
+	if (type < 0)
+	    break;
+
+	th = next[type];
+	next[type] = th->next;
+
 	if (th->function.acv == (actionf_v)NULL)
 	{
-	    for (i = 0; i < MAXCEILINGS;i++)
-		if (activeceilings[i] == (ceiling_t *)th)
-		    break;
-	    
-	    if (i<MAXCEILINGS)
+	    // only a ceiling on the active list is in stasis
+	    if (type == th_ceiling
+		&& ((ceiling_t *) th)->activeindex >= 0)
 	    {
                 saveg_write8(tc_ceiling);
 		saveg_write_pad();
@@ -1814,7 +1839,7 @@ void P_UnArchiveSpecials (void)
 			
 	  case tc_ceiling:
 	    saveg_read_pad();
-	    ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+	    ceiling = Z_PoolAlloc (&ceilingpool);
             saveg_read_ceiling_t(ceiling);
 	    ceiling->sector->specialdata = ceiling;
 
@@ -1827,7 +1852,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_door:
 	    saveg_read_pad();
-	    door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+	    door = Z_PoolAlloc (&doorpool);
             saveg_read_vldoor_t(door);
 	    door->sector->specialdata = door;
 	    door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
@@ -1836,7 +1861,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_floor:
 	    saveg_read_pad();
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+	    floor = Z_PoolAlloc (&floorpool);
             saveg_read_floormove_t(floor);
 	    floor->sector->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1845,7 +1870,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_plat:
 	    saveg_read_pad();
-	    plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+	    plat = Z_PoolAlloc (&platpool);
             saveg_read_plat_t(plat);
 	    plat->sector->specialdata = plat;
 
@@ -1858,7 +1883,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_flash:
 	    saveg_read_pad();
-	    flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+	    flash = Z_PoolAlloc (&flashpool);
             saveg_read_lightflash_t(flash);
 	    flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
 	    P_AddThinker (&flash->thinker);
@@ -1866,7 +1891,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_strobe:
 	    saveg_read_pad();
-	    strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+	    strobe = Z_PoolAlloc (&strobepool);
             saveg_read_strobe_t(strobe);
 	    strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
 	    P_AddThinker (&strobe->thinker);
@@ -1874,7 +1899,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_glow:
 	    saveg_read_pad();
-	    glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+	    glow = Z_PoolAlloc (&glowpool);
             saveg_read_glow_t(glow);
 	    glow->thinker.function.acp1 = (actionf_p1)T_Glow;
 	    P_AddThinker (&glow->thinker);
@@ -20,6 +20,8 @@
 
 
 #include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
 
 #include "z_zone.h"
 
@@ -31,6 +33,7 @@
 #include "g_game.h"
 
 #include "i_system.h"
+#include "i_timer.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -81,9 +84,10 @@ static int      totallines;
 // Blockmap size.
 int		bmapwidth;
 int		bmapheight;	// size in mapblocks
-short*		blockmap;	// int for larger maps
+int32_t*	blockmap;	// int for larger maps
 // offsets in blockmap are from here
-short*		blockmaplump;		
+int32_t*	blockmaplump;		
+int		blockmaplen;
 // origin of block map
 fixed_t		bmaporgx;
 fixed_t		bmaporgy;
@@ -109,6 +113,125 @@ mapthing_t*	deathmatch_p;
 mapthing_t	playerstarts[MAXPLAYERS];
 
 
+// Node formats, see doomdata.h.  The vertexes, segs, subsectors
+//  and nodes of a level are all loaded according to the format
+//  found in its NODES lump.
+typedef enum
+{
+    NODES_VANILLA,
+    NODES_DEEPBSP,
+    NODES_XNOD
+} nodeformat_t;
+
+static nodeformat_t	nodeformat;
+static int		nodeslump;	// XNOD keeps everything here
+
+// Sections of an XNOD lump, in order.
+enum
+{
+    XNOD_VERTEXES,
+    XNOD_SUBSECTORS,
+    XNOD_SEGS,
+    XNOD_NODES,
+    XNOD_END
+};
+
+// build the blockmap instead of loading it
+static boolean		createblockmap = false;
+
+
+// Reads a little endian 32 bit value, aligned or not.
+static int P_ReadLong (byte *p)
+{
+    int		value;
+
+    memcpy (&value, p, sizeof(value));
+
+    return LONG(value);
+}
+
+//
+// P_XNODSection
+// Returns where a section of an XNOD lump starts.  Each is a
+//  count and as many records, but for the vertexes, which have
+//  the number of original vertexes before the count.
+//
+static byte *P_XNODSection (byte *data, int section)
+{
+    byte*	p;
+
+    p = data + 4;		// past the magic
+
+    if (section > XNOD_VERTEXES)
+	p += 8 + P_ReadLong (p + 4) * 8;
+
+    if (section > XNOD_SUBSECTORS)
+	p += 4 + P_ReadLong (p) * 4;
+
+    if (section > XNOD_SEGS)
+	p += 4 + P_ReadLong (p) * sizeof(mapseg_xnod_t);
+
+    if (section > XNOD_NODES)
+	p += 4 + P_ReadLong (p) * sizeof(mapnode_v4_t);
+
+    return p;
+}
+
+//
+// P_CheckNodeFormat
+// Sets nodeformat from the magic at the start of a NODES lump.
+//
+static void P_CheckNodeFormat (int lump)
+{
+    byte*	data;
+    int		length;
+    int		start;
+    int		end;
+    int		i;
+
+    nodeformat = NODES_VANILLA;
+    nodeslump = lump;
+    length = W_LumpLength (lump);
+
+    if (length < 8)
+	return;
+
+    data = W_CacheLumpNum (lump, PU_STATIC);
+
+    if (!memcmp (data, NODES_DEEPBSP_MAGIC, 8))
+    {
+	nodeformat = NODES_DEEPBSP;
+    }
+    else if (!memcmp (data, NODES_XNOD_MAGIC, 4))
+    {
+	nodeformat = NODES_XNOD;
+
+	// walk the counts one section at a time, so that
+	//  a bad count is caught before it is followed
+	end = 4;
+
+	for (i=XNOD_SUBSECTORS ; i<=XNOD_END ; i++)
+	{
+	    start = end;
+
+	    if (start + (i == XNOD_SUBSECTORS ? 8 : 4) > length)
+		I_Error ("P_CheckNodeFormat: XNOD nodes are truncated");
+
+	    end = P_XNODSection (data, i) - data;
+
+	    if (end < start || end > length)
+		I_Error ("P_CheckNodeFormat: XNOD nodes are truncated");
+	}
+    }
+    else if (!memcmp (data, NODES_ZNOD_MAGIC, 4))
+    {
+	I_Error ("P_CheckNodeFormat: compressed ZDBSP nodes "
+		 "are not supported");
+    }
+
+    W_ReleaseLumpNum (lump);
+}
+
 
 
 
@@ -147,6 +270,45 @@ void P_LoadVertexes (int lump)
     W_ReleaseLumpNum(lump);
 }
 
+//
+// P_LoadXNODVertexes
+// Adds the vertexes the node builder made to those of the
+//  VERTEXES lump, before anything points at them.
+//
+void P_LoadXNODVertexes (int lump)
+{
+    byte*	data;
+    byte*	p;
+    vertex_t*	newvertexes;
+    int		orgverts;
+    int		newverts;
+    int		i;
+
+    data = W_CacheLumpNum (lump, PU_STATIC);
+    p = P_XNODSection (data, XNOD_VERTEXES);
+
+    orgverts = P_ReadLong (p);
+    newverts = P_ReadLong (p + 4);
+
+    if (orgverts < 0 || orgverts > numvertexes || newverts < 0)
+	I_Error ("P_LoadXNODVertexes: bad vertex counts");
+
+    newvertexes = Z_Malloc ((orgverts+newverts)*sizeof(vertex_t), PU_LEVEL, 0);
+    memcpy (newvertexes, vertexes, orgverts*sizeof(vertex_t));
+
+    for (i=0, p+=8 ; i<newverts ; i++, p+=8)
+    {
+	newvertexes[orgverts+i].x = P_ReadLong (p);
+	newvertexes[orgverts+i].y = P_ReadLong (p + 4);
+    }
+
+    Z_Free (vertexes);
+    vertexes = newvertexes;
+    numvertexes = orgverts + newverts;
+
+    W_ReleaseLumpNum(lump);
+}
+
 //
 // GetSectorAtNullAddress
 //
@@ -166,64 +328,147 @@ sector_t* GetSectorAtNullAddress(void)
     return &null_sector;
 }
 
+//
+// P_SetupSeg
+// Points a seg at its vertexes, line, side and sectors.
+// The angle and offset are left to the caller.
+//
+static void P_SetupSeg (seg_t* li, int v1, int v2, int linedef, int side)
+{
+    line_t*		ldef;
+    int                 sidenum;
+
+    li->v1 = &vertexes[v1];
+    li->v2 = &vertexes[v2];
+
+    ldef = &lines[linedef];
+    li->linedef = ldef;
+    li->sidedef = &sides[ldef->sidenum[side]];
+    li->frontsector = sides[ldef->sidenum[side]].sector;
+
+    if (ldef-> flags & ML_TWOSIDED)
+    {
+        sidenum = ldef->sidenum[side ^ 1];
+
+        // If the sidenum is out of range, this may be a "glass hack"
+        // impassible window.  Point at side #0 (this may not be
+        // the correct Vanilla behavior; however, it seems to work for
+        // OTTAWAU.WAD, which is the one place I've seen this trick
+        // used).
+
+        if (sidenum < 0 || sidenum >= numsides)
+        {
+            li->backsector = GetSectorAtNullAddress();
+        }
+        else
+        {
+            li->backsector = sides[sidenum].sector;
+        }
+    }
+    else
+    {
+        li->backsector = 0;
+    }
+}
+
+//
+// P_SegOffset
+// XNOD leaves out the seg offsets: the distance along the line
+//  from the start of the side to the start of the seg.
+//
+static fixed_t P_SegOffset (seg_t* li, int side)
+{
+    vertex_t*	v;
+    double	dx;
+    double	dy;
+
+    v = side ? li->linedef->v2 : li->linedef->v1;
+    dx = (double) li->v1->x - v->x;
+    dy = (double) li->v1->y - v->y;
+
+    return (fixed_t) sqrt (dx*dx + dy*dy);
+}
+
 //
 // P_LoadSegs
+// Indexes in the vanilla format are unsigned, for up to
+//  65535 vertexes and lines.
 //
 void P_LoadSegs (int lump)
 {
     byte*		data;
+    byte*		p;
     int			i;
     mapseg_t*		ml;
+    mapseg_v4_t*	ml4;
+    mapseg_xnod_t*	mlx;
     seg_t*		li;
-    line_t*		ldef;
-    int			linedef;
     int			side;
-    int                 sidenum;
-	
-    numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
+
+    if (nodeformat == NODES_XNOD)
+	lump = nodeslump;
+
+    data = W_CacheLumpNum (lump,PU_STATIC);
+
+    p = data;
+
+    if (nodeformat == NODES_XNOD)
+    {
+	p = P_XNODSection (data, XNOD_SEGS);
+	numsegs = P_ReadLong (p);
+	p += 4;
+    }
+    else if (nodeformat == NODES_DEEPBSP)
+	numsegs = W_LumpLength (lump) / sizeof(mapseg_v4_t);
+    else
+	numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
+
     segs = Z_Malloc (numsegs*sizeof(seg_t),PU_LEVEL,0);	
     memset (segs, 0, numsegs*sizeof(seg_t));
-    data = W_CacheLumpNum (lump,PU_STATIC);
 	
-    ml = (mapseg_t *)data;
     li = segs;
-    for (i=0 ; i<numsegs ; i++, li++, ml++)
+
+    if (nodeformat == NODES_XNOD)
     {
-	li->v1 = &vertexes[SHORT(ml->v1)];
-	li->v2 = &vertexes[SHORT(ml->v2)];
+	mlx = (mapseg_xnod_t *) p;
 
-	li->angle = (SHORT(ml->angle))<<16;
-	li->offset = (SHORT(ml->offset))<<16;
-	linedef = SHORT(ml->linedef);
-	ldef = &lines[linedef];
-	li->linedef = ldef;
-	side = SHORT(ml->side);
-	li->sidedef = &sides[ldef->sidenum[side]];
-	li->frontsector = sides[ldef->sidenum[side]].sector;
+	for (i=0 ; i<numsegs ; i++, li++, mlx++)
+	{
+	    side = mlx->side;
+	    P_SetupSeg (li, LONG(mlx->v1), LONG(mlx->v2),
+			(unsigned short) SHORT(mlx->linedef), side);
 
-        if (ldef-> flags & ML_TWOSIDED)
-        {
-            sidenum = ldef->sidenum[side ^ 1];
-
-            // If the sidenum is out of range, this may be a "glass hack"
-            // impassible window.  Point at side #0 (this may not be
-            // the correct Vanilla behavior; however, it seems to work for
-            // OTTAWAU.WAD, which is the one place I've seen this trick
-            // used).
-
-            if (sidenum < 0 || sidenum >= numsides)
-            {
-                li->backsector = GetSectorAtNullAddress();
-            }
-            else
-            {
-                li->backsector = sides[sidenum].sector;
-            }
-        }
-        else
-        {
-	    li->backsector = 0;
-        }
+	    li->angle = R_PointToAngle2 (li->v1->x, li->v1->y,
+					 li->v2->x, li->v2->y);
+	    li->offset = P_SegOffset (li, side);
+	}
+    }
+    else if (nodeformat == NODES_DEEPBSP)
+    {
+	ml4 = (mapseg_v4_t *)p;
+
+	for (i=0 ; i<numsegs ; i++, li++, ml4++)
+	{
+	    P_SetupSeg (li, LONG(ml4->v1), LONG(ml4->v2),
+			(unsigned short) SHORT(ml4->linedef), SHORT(ml4->side));
+
+	    li->angle = (SHORT(ml4->angle))<<16;
+	    li->offset = (SHORT(ml4->offset))<<16;
+	}
+    }
+    else
+    {
+	ml = (mapseg_t *)p;
+
+	for (i=0 ; i<numsegs ; i++, li++, ml++)
+	{
+	    P_SetupSeg (li, (unsigned short) SHORT(ml->v1),
+			(unsigned short) SHORT(ml->v2),
+			(unsigned short) SHORT(ml->linedef), SHORT(ml->side));
+
+	    li->angle = (SHORT(ml->angle))<<16;
+	    li->offset = (SHORT(ml->offset))<<16;
+	}
     }
 	
     W_ReleaseLumpNum(lump);
@@ -236,22 +481,65 @@ void P_LoadSegs (int lump)
 void P_LoadSubsectors (int lump)
 {
     byte*		data;
+    byte*		p;
     int			i;
+    int			firstseg;
     mapsubsector_t*	ms;
+    mapsubsector_v4_t*	ms4;
     subsector_t*	ss;
-	
-    numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
-    subsectors = Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);	
+
+    if (nodeformat == NODES_XNOD)
+	lump = nodeslump;
+
     data = W_CacheLumpNum (lump,PU_STATIC);
-	
-    ms = (mapsubsector_t *)data;
+    p = data;
+
+    if (nodeformat == NODES_XNOD)
+    {
+	p = P_XNODSection (data, XNOD_SUBSECTORS);
+	numsubsectors = P_ReadLong (p);
+	p += 4;
+    }
+    else if (nodeformat == NODES_DEEPBSP)
+	numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_v4_t);
+    else
+	numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
+
+    subsectors = Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);	
     memset (subsectors,0, numsubsectors*sizeof(subsector_t));
     ss = subsectors;
     
-    for (i=0 ; i<numsubsectors ; i++, ss++, ms++)
+    if (nodeformat == NODES_XNOD)
     {
-	ss->numlines = SHORT(ms->numsegs);
-	ss->firstline = SHORT(ms->firstseg);
+	// only the counts: the segs follow on from each other
+	firstseg = 0;
+
+	for (i=0 ; i<numsubsectors ; i++, ss++, p+=4)
+	{
+	    ss->numlines = P_ReadLong (p);
+	    ss->firstline = firstseg;
+	    firstseg += ss->numlines;
+	}
+    }
+    else if (nodeformat == NODES_DEEPBSP)
+    {
+	ms4 = (mapsubsector_v4_t *)p;
+
+	for (i=0 ; i<numsubsectors ; i++, ss++, ms4++)
+	{
+	    ss->numlines = (unsigned short) SHORT(ms4->numsegs);
+	    ss->firstline = LONG(ms4->firstseg);
+	}
+    }
+    else
+    {
+	ms = (mapsubsector_t *)p;
+
+	for (i=0 ; i<numsubsectors ; i++, ss++, ms++)
+	{
+	    ss->numlines = (unsigned short) SHORT(ms->numsegs);
+	    ss->firstline = (unsigned short) SHORT(ms->firstseg);
+	}
     }
 	
     W_ReleaseLumpNum(lump);
@@ -297,31 +585,74 @@ void P_LoadSectors (int lump)
 //
 void P_LoadNodes (int lump)
 {
-    byte*	data;
-    int		i;
-    int		j;
-    int		k;
-    mapnode_t*	mn;
-    node_t*	no;
+    byte*		data;
+    int			i;
+    int			j;
+    int			k;
+    unsigned int	child;
+    mapnode_t*		mn;
+    mapnode_v4_t*	mn4;
+    node_t*		no;
 	
-    numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
-    nodes = Z_Malloc (numnodes*sizeof(node_t),PU_LEVEL,0);	
     data = W_CacheLumpNum (lump,PU_STATIC);
-	
-    mn = (mapnode_t *)data;
-    no = nodes;
+
+    if (nodeformat == NODES_VANILLA)
+    {
+	numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
+	nodes = Z_Malloc (numnodes*sizeof(node_t),PU_LEVEL,0);	
+
+	mn = (mapnode_t *)data;
+	no = nodes;
     
-    for (i=0 ; i<numnodes ; i++, no++, mn++)
+	for (i=0 ; i<numnodes ; i++, no++, mn++)
+	{
+	    no->x = SHORT(mn->x)<<FRACBITS;
+	    no->y = SHORT(mn->y)<<FRACBITS;
+	    no->dx = SHORT(mn->dx)<<FRACBITS;
+	    no->dy = SHORT(mn->dy)<<FRACBITS;
+	    for (j=0 ; j<2 ; j++)
+	    {
+		child = (unsigned short) SHORT(mn->children[j]);
+
+		if (child & NF_SUBSECTOR_VANILLA)
+		    child = (child & ~NF_SUBSECTOR_VANILLA) | NF_SUBSECTOR;
+
+		no->children[j] = child;
+		for (k=0 ; k<4 ; k++)
+		    no->bbox[j][k] = SHORT(mn->bbox[j][k])<<FRACBITS;
+	    }
+	}
+
+	W_ReleaseLumpNum(lump);
+	return;
+    }
+
+    // DeePBSP and XNOD nodes only differ in where they are
+    if (nodeformat == NODES_XNOD)
+    {
+	mn4 = (mapnode_v4_t *) (P_XNODSection (data, XNOD_NODES) + 4);
+	numnodes = P_ReadLong ((byte *) mn4 - 4);
+    }
+    else
     {
-	no->x = SHORT(mn->x)<<FRACBITS;
-	no->y = SHORT(mn->y)<<FRACBITS;
-	no->dx = SHORT(mn->dx)<<FRACBITS;
-	no->dy = SHORT(mn->dy)<<FRACBITS;
+	mn4 = (mapnode_v4_t *) (data + 8);
+	numnodes = (W_LumpLength (lump) - 8) / sizeof(mapnode_v4_t);
+    }
+
+    nodes = Z_Malloc (numnodes*sizeof(node_t),PU_LEVEL,0);	
+    no = nodes;
+
+    for (i=0 ; i<numnodes ; i++, no++, mn4++)
+    {
+	no->x = SHORT(mn4->x)<<FRACBITS;
+	no->y = SHORT(mn4->y)<<FRACBITS;
+	no->dx = SHORT(mn4->dx)<<FRACBITS;
+	no->dy = SHORT(mn4->dy)<<FRACBITS;
 	for (j=0 ; j<2 ; j++)
 	{
-	    no->children[j] = SHORT(mn->children[j]);
+	    no->children[j] = LONG(mn4->children[j]);
 	    for (k=0 ; k<4 ; k++)
-		no->bbox[j][k] = SHORT(mn->bbox[j][k])<<FRACBITS;
+		no->bbox[j][k] = SHORT(mn4->bbox[j][k])<<FRACBITS;
 	}
     }
 	
@@ -388,11 +719,14 @@ void P_LoadThings (int lump)
 //
 // P_LoadLineDefs
 // Also counts secret lines for intermissions.
+// Vertex and side numbers are unsigned, with 0xffff
+//  for no side, for up to 65535 of each.
 //
 void P_LoadLineDefs (int lump)
 {
     byte*		data;
     int			i;
+    int			j;
     maplinedef_t*	mld;
     line_t*		ld;
     vertex_t*		v1;
@@ -410,8 +744,8 @@ void P_LoadLineDefs (int lump)
 	ld->flags = SHORT(mld->flags);
 	ld->special = SHORT(mld->special);
 	ld->tag = SHORT(mld->tag);
-	v1 = ld->v1 = &vertexes[SHORT(mld->v1)];
-	v2 = ld->v2 = &vertexes[SHORT(mld->v2)];
+	v1 = ld->v1 = &vertexes[(unsigned short) SHORT(mld->v1)];
+	v2 = ld->v2 = &vertexes[(unsigned short) SHORT(mld->v2)];
 	ld->dx = v2->x - v1->x;
 	ld->dy = v2->y - v1->y;
 	
@@ -449,8 +783,13 @@ void P_LoadLineDefs (int lump)
 	    ld->bbox[BOXTOP] = v1->y;
 	}
 
-	ld->sidenum[0] = SHORT(mld->sidenum[0]);
-	ld->sidenum[1] = SHORT(mld->sidenum[1]);
+	for (j=0 ; j<2 ; j++)
+	{
+	    ld->sidenum[j] = (unsigned short) SHORT(mld->sidenum[j]);
+
+	    if (ld->sidenum[j] == 0xffff)
+		ld->sidenum[j] = -1;
+	}
 
 	if (ld->sidenum[0] != -1)
 	    ld->frontsector = sides[ld->sidenum[0]].sector;
@@ -491,35 +830,219 @@ void P_LoadSideDefs (int lump)
 	sd->toptexture = R_TextureNumForName(msd->toptexture);
 	sd->bottomtexture = R_TextureNumForName(msd->bottomtexture);
 	sd->midtexture = R_TextureNumForName(msd->midtexture);
-	sd->sector = &sectors[SHORT(msd->sector)];
+	sd->sector = &sectors[(unsigned short) SHORT(msd->sector)];
     }
 
     W_ReleaseLumpNum(lump);
 }
 
 
+//
+// P_ClearBlockLinks
+// Clear out mobj chains
+//
+static void P_ClearBlockLinks (void)
+{
+    int		count;
+
+    count = sizeof(*blocklinks) * bmapwidth * bmapheight;
+    blocklinks = Z_Malloc(count, PU_LEVEL, 0);
+    memset(blocklinks, 0, count);
+}
+
+//
+// P_CheckBlockMap
+// True if every block points at a list that ends inside
+//  the lump.
+//
+boolean P_CheckBlockMap (void)
+{
+    int		numblocks;
+    int		i;
+    int		j;
+
+    if (bmapwidth <= 0 || bmapheight <= 0
+     || bmapheight > (blockmaplen - 4) / bmapwidth)
+	return false;
+
+    numblocks = bmapwidth * bmapheight;
+
+    for (i=0 ; i<numblocks ; i++)
+    {
+	for (j = blockmap[i] ; j >= 0 && j < blockmaplen ; j++)
+	    if (blockmaplump[j] == -1)
+		break;
+
+	if (j < 0 || j >= blockmaplen)
+	    return false;
+    }
+
+    return true;
+}
+
+//
+// P_CreateBlockMap
+// Builds the blockmap from the lines, laid out as the lump
+//  would be: the header, the offset of each block's list, then
+//  the lists, each a 0, the lines touching the block and a -1,
+//  as the node builders have always made them.
+//
+static void P_CreateBlockMap (void)
+{
+    fixed_t	bbox[4];
+    fixed_t	box[4];
+    int*	fill;
+    int32_t*	list;
+    line_t*	ld;
+    int		numblocks;
+    int		pass;
+    int		total;
+    int		i;
+    int		x;
+    int		y;
+    int		x1;
+    int		x2;
+    int		y1;
+    int		y2;
+
+    M_ClearBox (bbox);
+
+    for (i=0, ld=lines ; i<numlines ; i++, ld++)
+    {
+	M_AddToBox (bbox, ld->v1->x, ld->v1->y);
+	M_AddToBox (bbox, ld->v2->x, ld->v2->y);
+    }
+
+    // no lines: a single block at the origin
+    if (!numlines)
+	bbox[BOXTOP] = bbox[BOXBOTTOM] = bbox[BOXLEFT] = bbox[BOXRIGHT] = 0;
+
+    // the origin on a whole map unit, as in the lump; the
+    //  extent of the map does not fit in a fixed_t, hence
+    //  the unsigned differences
+    bmaporgx = bbox[BOXLEFT] & ~(FRACUNIT-1);
+    bmaporgy = bbox[BOXBOTTOM] & ~(FRACUNIT-1);
+    bmapwidth = ((unsigned) (bbox[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT) + 1;
+    bmapheight = ((unsigned) (bbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT) + 1;
+
+    numblocks = bmapwidth * bmapheight;
+
+    // Count the lines of each block in the first pass, and put
+    //  them in their lists in the second.  fill holds the counts,
+    //  then where the next line of each list goes.
+    fill = Z_Malloc (numblocks*sizeof(*fill), PU_STATIC, 0);
+    memset (fill, 0, numblocks*sizeof(*fill));
+    list = NULL;
+
+    for (pass=0 ; pass<2 ; pass++)
+    {
+	for (i=0, ld=lines ; i<numlines ; i++, ld++)
+	{
+	    x1 = (unsigned) (ld->bbox[BOXLEFT] - bmaporgx) >> MAPBLOCKSHIFT;
+	    x2 = (unsigned) (ld->bbox[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT;
+	    y1 = (unsigned) (ld->bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
+	    y2 = (unsigned) (ld->bbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT;
+
+	    for (y=y1 ; y<=y2 ; y++)
+	    {
+		box[BOXBOTTOM] = (unsigned) bmaporgy + (y << MAPBLOCKSHIFT);
+		box[BOXTOP] = (unsigned) box[BOXBOTTOM] + MAPBLOCKSIZE;
+
+		for (x=x1 ; x<=x2 ; x++)
+		{
+		    box[BOXLEFT] = (unsigned) bmaporgx + (x << MAPBLOCKSHIFT);
+		    box[BOXRIGHT] = (unsigned) box[BOXLEFT] + MAPBLOCKSIZE;
+
+		    // the bounding boxes touch; does the line?
+		    if (P_BoxOnLineSide (box, ld) != -1)
+			continue;
+
+		    if (pass == 0)
+			fill[y*bmapwidth+x]++;
+		    else
+			list[fill[y*bmapwidth+x]++] = i;
+		}
+	    }
+	}
+
+	if (pass == 1)
+	    break;
+
+	// lay the lists out after the offsets
+	total = 4 + numblocks;
+
+	for (i=0 ; i<numblocks ; i++)
+	    total += fill[i] + 2;
+
+	blockmaplen = total;
+	blockmaplump = Z_Malloc (total*sizeof(*blockmaplump), PU_LEVEL, 0);
+	blockmap = blockmaplump + 4;
+	list = blockmaplump;
+
+	blockmaplump[0] = bmaporgx >> FRACBITS;
+	blockmaplump[1] = bmaporgy >> FRACBITS;
+	blockmaplump[2] = bmapwidth;
+	blockmaplump[3] = bmapheight;
+
+	total = 4 + numblocks;
+
+	for (i=0 ; i<numblocks ; i++)
+	{
+	    blockmap[i] = total;
+	    list[total] = 0;
+	    list[total+fill[i]+1] = -1;
+	    total += fill[i] + 2;
+	    fill[i] = blockmap[i] + 1;
+	}
+    }
+
+    Z_Free (fill);
+}
+
 //
 // P_LoadBlockMap
+// Offsets and line numbers are unsigned, but for the -1 ending
+//  each list, so a lump of up to 128 KB can be addressed.  If
+//  the lump is bad or too big even for that, or -blockmap is
+//  given, the blockmap is built from the lines instead.
 //
 void P_LoadBlockMap (int lump)
 {
-    int i;
-    int count;
-    int lumplen;
+    int		i;
+    int		count;
+    int		lumplen;
+    short*	data;
+    short	t;
 
     lumplen = W_LumpLength(lump);
     count = lumplen / 2;
-	
-    blockmaplump = Z_Malloc(lumplen, PU_LEVEL, NULL);
-    W_ReadLump(lump, blockmaplump);
+
+    if (createblockmap || count < 4 || count > 0x10000)
+    {
+	P_CreateBlockMap ();
+	P_ClearBlockLinks ();
+	return;
+    }
+
+    blockmaplump = Z_Malloc(count*sizeof(*blockmaplump), PU_LEVEL, NULL);
+    blockmaplen = count;
     blockmap = blockmaplump + 4;
 
+    data = W_CacheLumpNum(lump, PU_STATIC);
+
     // Swap all short integers to native byte ordering.
-  
+
     for (i=0; i<count; i++)
     {
-	blockmaplump[i] = SHORT(blockmaplump[i]);
+	t = SHORT(data[i]);
+
+	if (i < 4 || t == -1)
+	    blockmaplump[i] = t;
+	else
+	    blockmaplump[i] = (unsigned short) t;
     }
+
+    W_ReleaseLumpNum(lump);
 		
     // Read the header
 
@@ -527,12 +1050,14 @@ void P_LoadBlockMap (int lump)
     bmaporgy = blockmaplump[1]<<FRACBITS;
     bmapwidth = blockmaplump[2];
     bmapheight = blockmaplump[3];
-	
-    // Clear out mobj chains
 
-    count = sizeof(*blocklinks) * bmapwidth * bmapheight;
-    blocklinks = Z_Malloc(count, PU_LEVEL, 0);
-    memset(blocklinks, 0, count);
+    if (!P_CheckBlockMap ())
+    {
+	Z_Free (blockmaplump);
+	P_CreateBlockMap ();
+    }
+
+    P_ClearBlockLinks ();
 }
 
 
@@ -737,6 +1262,185 @@ static void P_LoadReject(int lumpnum)
     }
 }
 
+//
+// P_MapLumpName
+// Builds the name of the map marker lump.
+//
+static void P_MapLumpName (int episode, int map, char *lumpname)
+{
+    if ( gamemode == commercial)
+    {
+	if (map<10)
+	    DEH_snprintf(lumpname, 9, "map0%i", map);
+	else
+	    DEH_snprintf(lumpname, 9, "map%i", map);
+    }
+    else
+    {
+	lumpname[0] = 'E';
+	lumpname[1] = '0' + episode;
+	lumpname[2] = 'M';
+	lumpname[3] = '0' + map;
+	lumpname[4] = 0;
+    }
+}
+
+
+
+//
+// LEVEL PREFETCH
+// While the intermission runs, a thread reads the lumps of
+//  the next map and the flats and wall patches it refers to
+//  into the WAD staging area (see W_BeginStaging), so that
+//  P_SetupLevel and R_PrecacheLevel do not wait on the disk.
+// The thread only reads lumps; everything touching the zone
+//  stays on the main thread.
+//
+
+// print the zone telemetry as each level is set up
+static boolean		zonestats = false;
+
+static pthread_t	prefetchthread;
+static boolean		prefetching = false;
+static volatile boolean	prefetchstop;
+static int		prefetchlump;
+static int		prefetchbudget = 2048*1024;
+
+static void P_PrefetchTexture (char *name)
+{
+    int		tex;
+    int		patch;
+    int		lump;
+
+    tex = R_CheckTextureNumForName (name);
+
+    if (tex <= 0)
+	return;
+
+    for (patch=0 ; !prefetchstop ; patch++)
+    {
+	lump = R_TexturePatchLump (tex, patch);
+
+	if (lump < 0)
+	    break;
+
+	W_StageLump (lump);
+    }
+}
+
+static void P_PrefetchFlat (char *name)
+{
+    int		lump;
+
+    lump = W_CheckNumForName (name);
+
+    // only the flat R_FlatNumForName would find
+    if (lump >= firstflat && lump <= lastflat)
+	W_StageLump (lump);
+}
+
+static void *P_PrefetchThread (void *arg)
+{
+    byte		*data;
+    mapsector_t		*ms;
+    mapsidedef_t	*msd;
+    int			count;
+    int			i;
+
+    for (i=ML_THINGS ; i<=ML_BLOCKMAP && !prefetchstop ; i++)
+	W_StageLump (prefetchlump+i);
+
+    data = W_StageLump (prefetchlump+ML_SECTORS);
+
+    if (data != NULL)
+    {
+	count = W_LumpLength (prefetchlump+ML_SECTORS) / sizeof(mapsector_t);
+	ms = (mapsector_t *)data;
+
+	for (i=0 ; i<count && !prefetchstop ; i++, ms++)
+	{
+	    P_PrefetchFlat (ms->floorpic);
+	    P_PrefetchFlat (ms->ceilingpic);
+	}
+    }
+
+    data = W_StageLump (prefetchlump+ML_SIDEDEFS);
+
+    if (data != NULL)
+    {
+	count = W_LumpLength (prefetchlump+ML_SIDEDEFS) / sizeof(mapsidedef_t);
+	msd = (mapsidedef_t *)data;
+
+	for (i=0 ; i<count && !prefetchstop ; i++, msd++)
+	{
+	    P_PrefetchTexture (msd->midtexture);
+	    P_PrefetchTexture (msd->toptexture);
+	    P_PrefetchTexture (msd->bottomtexture);
+	}
+    }
+
+    return NULL;
+}
+
+//
+// P_StopPrefetch
+// Waits for the prefetch thread; the staged lumps are then
+//  handed out by W_ReadLump.
+//
+static void P_StopPrefetch (void)
+{
+    if (!prefetching)
+	return;
+
+    prefetchstop = true;
+    pthread_join (prefetchthread, NULL);
+    W_EndStaging ();
+    prefetching = false;
+}
+
+//
+// P_CancelPrefetch
+//
+void P_CancelPrefetch (void)
+{
+    P_StopPrefetch ();
+    W_DropStagedLumps ();
+}
+
+//
+// P_PrefetchLevel
+// Called when the intermission starts with the level that
+//  will be loaded next.
+//
+void P_PrefetchLevel (int episode, int map)
+{
+    char	lumpname[9];
+
+    P_StopPrefetch ();
+
+    if (prefetchbudget <= 0)
+	return;
+
+    P_MapLumpName (episode, map, lumpname);
+    prefetchlump = W_CheckNumForName (lumpname);
+
+    if (prefetchlump < 0
+     || prefetchlump+ML_BLOCKMAP >= (int) numlumps)
+	return;
+
+    W_BeginStaging (prefetchbudget);
+    prefetchstop = false;
+
+    if (pthread_create (&prefetchthread, NULL, P_PrefetchThread, NULL))
+    {
+	W_EndStaging ();
+	return;
+    }
+
+    prefetching = true;
+}
+
+
 //
 // P_SetupLevel
 //
@@ -750,7 +1454,13 @@ P_SetupLevel
     int		i;
     char	lumpname[9];
     int		lumpnum;
+    void*	cache;
+    int		starttime;
 	
+    starttime = I_GetTimeMS ();
+
+    P_StopPrefetch ();
+
     totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
     wminfo.partime = 180;
     for (i=0 ; i<MAXPLAYERS ; i++)
@@ -766,45 +1476,60 @@ P_SetupLevel
     // Make sure all sounds are stopped before Z_FreeTags.
     S_Start ();			
 
+    // all thinkers at once
+    Z_ClearArena (&levelarena);
     Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 
+    // give back what the last level made the zone grow by
+    R_ReleaseRegionData ();
+    Z_ReleaseRegions ();
+
     // UNUSED W_Profile ();
     P_InitThinkers ();
 	   
     // find map name
-    if ( gamemode == commercial)
-    {
-	if (map<10)
-	    DEH_snprintf(lumpname, 9, "map0%i", map);
-	else
-	    DEH_snprintf(lumpname, 9, "map%i", map);
-    }
-    else
-    {
-	lumpname[0] = 'E';
-	lumpname[1] = '0' + episode;
-	lumpname[2] = 'M';
-	lumpname[3] = '0' + map;
-	lumpname[4] = 0;
-    }
+    P_MapLumpName (episode, map, lumpname);
 
     lumpnum = W_GetNumForName (lumpname);
 	
     leveltime = 0;
 	
+    cache = P_ReadLevelCache (lumpnum);
+
     // note: most of this ordering is important	
-    P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
+    P_CheckNodeFormat (lumpnum+ML_NODES);
     P_LoadVertexes (lumpnum+ML_VERTEXES);
+    if (nodeformat == NODES_XNOD)
+	P_LoadXNODVertexes (lumpnum+ML_NODES);
     P_LoadSectors (lumpnum+ML_SECTORS);
     P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
-
-    P_LoadLineDefs (lumpnum+ML_LINEDEFS);
     P_LoadSubsectors (lumpnum+ML_SSECTORS);
-    P_LoadNodes (lumpnum+ML_NODES);
-    P_LoadSegs (lumpnum+ML_SEGS);
 
-    P_GroupLines ();
-    P_LoadReject (lumpnum+ML_REJECT);
+    // lines, segs, sector line lists, blockmap and reject
+    //  come ready made from the level cache, if it fits
+    if (cache != NULL && !P_RelocateLevelCache (cache))
+    {
+	Z_Free (cache);
+	cache = NULL;
+    }
+
+    if (cache != NULL)
+    {
+	P_LoadNodes (lumpnum+ML_NODES);
+    }
+    else
+    {
+	P_LoadLineDefs (lumpnum+ML_LINEDEFS);
+	P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
+	P_LoadNodes (lumpnum+ML_NODES);
+	P_LoadSegs (lumpnum+ML_SEGS);
+
+	P_GroupLines ();
+	P_LoadReject (lumpnum+ML_REJECT);
+	P_WriteLevelCache (lumpnum);
+    }
+
+    P_InitBlockArrays ();
 
     bodyqueslot = 0;
     deathmatch_p = deathmatchstarts;
@@ -835,17 +1560,84 @@ P_SetupLevel
     if (precache)
 	R_PrecacheLevel ();
 
+    // whatever the prefetch read but the level did not use,
+    //  or all of it if the prefetch was for another map
+    W_DropStagedLumps ();
+
     //printf ("free memory: 0x%x\n", Z_FreeMemory());
 
+    if (zonestats)
+    {
+	printf ("%s loaded in %i ms\n", lumpname, I_GetTimeMS () - starttime);
+	Z_DumpStats (stdout);
+    }
 }
 
 
 
+// let the playsim lists grow past the vanilla limits
+static boolean		removelimits = false;
+
+//
+// P_VanillaOverruns
+// True when overrunning the vanilla limits must do what it did
+// in vanilla, which demos and netgames depend on.
+//
+boolean P_VanillaOverruns (void)
+{
+    return !removelimits || demoplayback || demorecording || netgame;
+}
+
+
 //
 // P_Init
 //
 void P_Init (void)
 {
+    int		p;
+
+    //!
+    // @arg <kb>
+    //
+    // Memory used to read the next level ahead during the
+    // intermission.  0 disables the prefetch.
+    //
+
+    p = M_CheckParmWithArgs ("-prefetchkb", 1);
+
+    if (p)
+	prefetchbudget = atoi (myargv[p+1]) * 1024;
+
+    //!
+    // Print the zone memory use by tag and by call site after
+    // each level is loaded, and the memory use of the process as
+    // the zone grows and shrinks, to help size -mb and -maxmb.
+    //
+
+    zonestats = M_CheckParm ("-zonestats") > 0;
+
+    //!
+    // @category compat
+    //
+    // Let the playsim lists grow past the vanilla limits instead
+    // of emulating what overrunning them did.  Ignored while a
+    // demo is played back or recorded, and in netgames.
+    //
+
+    removelimits = M_CheckParm ("-removelimits") > 0;
+
+    //!
+    // @category mod
+    //
+    // Build the blockmap of each level from its lines rather
+    // than use the BLOCKMAP lump.
+    //
+
+    createblockmap = M_CheckParm ("-blockmap") > 0;
+
+    P_InitLevelCache ();
+    P_InitSight ();
+
     P_InitSwitchList ();
     P_InitPicAnims ();
     R_InitSprites (sprnames);
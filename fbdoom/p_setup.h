@@ -31,6 +31,12 @@ P_SetupLevel
   int		playermask,
   skill_t	skill);
 
+// Reads the next level ahead, called when the intermission starts.
+void P_PrefetchLevel (int episode, int map);
+
+// Stops the read ahead and frees what it read, when no level follows.
+void P_CancelPrefetch (void);
+
 // Called by startup code.
 void P_Init (void);
 
@@ -18,9 +18,14 @@
 
 
 
+#include <stdio.h>
+#include <string.h>
+
 #include "doomdef.h"
+#include "doomstat.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "p_local.h"
 
 // State.
@@ -40,6 +45,36 @@ fixed_t		t2y;
 int		sightcounts[2];
 
 
+//
+// SIGHT CACHE
+// Monsters look at the same target several times in a tic,
+// from A_Look, A_Chase, P_CheckMissileRange and the attacks.
+// The answer only depends on where the two are and on the
+// sector heights, so it is kept until the end of the tic or
+// the next height change, whichever comes first.
+//
+#define SIGHTCACHESIZE	256	// power of two
+
+typedef struct
+{
+    mobj_t*		t1;
+    mobj_t*		t2;
+    fixed_t		x1, y1, z1, h1;
+    fixed_t		x2, y2, z2, h2;
+    unsigned int	stamp;
+    boolean		result;
+} sightcache_t;
+
+static sightcache_t	sightcache[SIGHTCACHESIZE];
+static unsigned int	sightstamp = 1;
+
+static int		sighthits;
+static int		sightmisses;
+
+// -checksight: trace every hit again and compare
+static boolean		sightcheck;
+
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -291,6 +326,75 @@ boolean P_CrossBSPNode (int bspnum)
 }
 
 
+//
+// P_ClearSightCache
+// Called at the start of every tic and whenever
+// a floor or ceiling moves.
+//
+void P_ClearSightCache (void)
+{
+    if (++sightstamp == 0)
+    {
+	memset (sightcache, 0, sizeof(sightcache));
+	sightstamp = 1;
+    }
+}
+
+
+static void P_PrintSightStats (void)
+{
+    printf ("P_CheckSight: %i rejected, %i traced, "
+	    "%i cache hits, %i misses\n",
+	    sightcounts[0], sightcounts[1], sighthits, sightmisses);
+}
+
+
+void P_InitSight (void)
+{
+    //!
+    // @category obscure
+    //
+    // Trace the line of sight again on every sight cache hit
+    // and stop with an error if the answers differ.  Prints
+    // the hit rate on exit.
+    //
+
+    sightcheck = M_CheckParm ("-checksight") > 0;
+
+    if (sightcheck)
+	I_AtExit (P_PrintSightStats, false);
+}
+
+
+//
+// P_TraceSight
+// The full check against the BSP.
+//
+static boolean
+P_TraceSight
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    sightcounts[1]++;
+
+    validcount++;
+	
+    sightzstart = t1->z + t1->height - (t1->height>>2);
+    topslope = (t2->z+t2->height) - sightzstart;
+    bottomslope = (t2->z) - sightzstart;
+	
+    strace.x = t1->x;
+    strace.y = t1->y;
+    t2x = t2->x;
+    t2y = t2->y;
+    strace.dx = t2->x - t1->x;
+    strace.dy = t2->y - t1->y;
+
+    // the head node is the last node output
+    return P_CrossBSPNode (numnodes-1);	
+}
+
+
 //
 // P_CheckSight
 // Returns true
@@ -307,6 +411,8 @@ P_CheckSight
     int		pnum;
     int		bytenum;
     int		bitnum;
+    sightcache_t*	sc;
+    boolean	result;
     
     // First check for trivial rejection.
 
@@ -327,24 +433,47 @@ P_CheckSight
     }
 
     // An unobstructed LOS is possible.
-    // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    // Asked already this tic, from the same spots?
+    sc = &sightcache[(((intptr_t) t1 >> 4) ^ ((intptr_t) t2 >> 2))
+		     & (SIGHTCACHESIZE-1)];
+
+    if (sc->stamp == sightstamp
+	&& sc->t1 == t1 && sc->t2 == t2
+	&& sc->x1 == t1->x && sc->y1 == t1->y
+	&& sc->z1 == t1->z && sc->h1 == t1->height
+	&& sc->x2 == t2->x && sc->y2 == t2->y
+	&& sc->z2 == t2->z && sc->h2 == t2->height)
+    {
+	sighthits++;
 
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+	if (sightcheck && P_TraceSight (t1, t2) != sc->result)
+	{
+	    I_Error ("P_CheckSight: cached sight differs from trace "
+		     "at leveltime %i", leveltime);
+	}
 
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+	return sc->result;
+    }
+
+    sightmisses++;
+
+    // Now look from eyes of t1 to any part of t2.
+    result = P_TraceSight (t1, t2);
+
+    sc->t1 = t1;
+    sc->t2 = t2;
+    sc->x1 = t1->x;
+    sc->y1 = t1->y;
+    sc->z1 = t1->z;
+    sc->h1 = t1->height;
+    sc->x2 = t2->x;
+    sc->y2 = t2->y;
+    sc->z2 = t2->z;
+    sc->h2 = t2->height;
+    sc->stamp = sightstamp;
+    sc->result = result;
+
+    return result;
 }
 
 
@@ -176,6 +176,7 @@ typedef struct
 #define SLOWDARK			35
 
 void    P_SpawnFireFlicker (sector_t* sector);
+void    T_FireFlicker (fireflicker_t* flick);
 void    T_LightFlash (lightflash_t* flash);
 void    P_SpawnLightFlash (sector_t* sector);
 void    T_StrobeFlash (strobe_t* flash);
@@ -238,12 +239,14 @@ typedef struct
 #define MAXSWITCHES		50
 
  // 4 players, 4 buttons each at once, max.
+ // The list starts this size and grows as needed.
 #define MAXBUTTONS		16
 
  // 1 second, in ticks. 
 #define BUTTONTIME      35             
 
-extern button_t	buttonlist[MAXBUTTONS]; 
+extern button_t*	buttonlist;
+extern int		maxbuttons;
 
 void
 P_ChangeSwitchTexture
@@ -293,6 +296,9 @@ typedef struct
     boolean	crush;
     int		tag;
     plattype_e	type;
+
+    // index in activeplats
+    int		activeindex;
     
 } plat_t;
 
@@ -300,10 +306,11 @@ typedef struct
 
 #define PLATWAIT		3
 #define PLATSPEED		FRACUNIT
-#define MAXPLATS		30
+#define MAXPLATS		30	// initial size of activeplats
 
 
-extern plat_t*	activeplats[MAXPLATS];
+extern plat_t**	activeplats;
+extern int	numactiveplats;
 
 void    T_PlatRaise(plat_t*	plat);
 
@@ -503,6 +510,9 @@ typedef struct
     // ID
     int		tag;                   
     int		olddirection;
+
+    // index in activeceilings, -1 if it never made the list
+    int		activeindex;
     
 } ceiling_t;
 
@@ -512,9 +522,10 @@ typedef struct
 
 #define CEILSPEED		FRACUNIT
 #define CEILWAIT		150
-#define MAXCEILINGS		30
+#define MAXCEILINGS		30	// vanilla limit, initial size
 
-extern ceiling_t*	activeceilings[MAXCEILINGS];
+extern ceiling_t**	activeceilings;
+extern int		numactiveceilings;
 
 int
 EV_DoCeiling
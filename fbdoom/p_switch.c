@@ -18,8 +18,10 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 
 #include "i_system.h"
+#include "z_zone.h"
 #include "deh_main.h"
 #include "doomdef.h"
 #include "p_local.h"
@@ -92,7 +94,8 @@ switchlist_t alphSwitchList[] =
 
 int		switchlist[MAXSWITCHES * 2];
 int		numswitches;
-button_t        buttonlist[MAXBUTTONS];
+button_t*       buttonlist;
+int		maxbuttons;
 
 //
 // P_InitSwitchList
@@ -139,6 +142,10 @@ void P_InitSwitchList(void)
 	    switchlist[index++] = R_TextureNumForName(DEH_String(alphSwitchList[i].name2));
 	}
     }
+
+    maxbuttons = MAXBUTTONS;
+    buttonlist = Z_Malloc(maxbuttons*sizeof(button_t), PU_STATIC, 0);
+    memset(buttonlist, 0, maxbuttons*sizeof(button_t));
 }
 
 
@@ -153,9 +160,10 @@ P_StartButton
   int		time )
 {
     int		i;
+    button_t*	newlist;
     
     // See if button is already pressed
-    for (i = 0;i < MAXBUTTONS;i++)
+    for (i = 0;i < maxbuttons;i++)
     {
 	if (buttonlist[i].btimer
 	    && buttonlist[i].line == line)
@@ -167,7 +175,7 @@ P_StartButton
     
 
     
-    for (i = 0;i < MAXBUTTONS;i++)
+    for (i = 0;i < maxbuttons;i++)
     {
 	if (!buttonlist[i].btimer)
 	{
@@ -179,8 +187,17 @@ P_StartButton
 	    return;
 	}
     }
-    
-    I_Error("P_StartButton: no button slots left!");
+
+    // No slot left: double the list and take the first new one.
+    newlist = Z_Malloc(maxbuttons*2*sizeof(button_t), PU_STATIC, 0);
+    memcpy(newlist, buttonlist, maxbuttons*sizeof(button_t));
+    memset(newlist+maxbuttons, 0, maxbuttons*sizeof(button_t));
+    Z_Free(buttonlist);
+
+    buttonlist = newlist;
+    maxbuttons *= 2;
+
+    P_StartButton(line, w, texture, time);
 }
 
 
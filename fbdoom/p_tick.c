@@ -18,6 +18,7 @@
 //
 
 
+#include "i_system.h"
 #include "z_zone.h"
 #include "p_local.h"
 
@@ -28,7 +29,7 @@ int	leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
+// All thinkers should be allocated from the pools below
 // so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
@@ -36,8 +37,42 @@ int	leveltime;
 
 
 
-// Both the head and tail of the thinker list.
-thinker_t	thinkercap;
+// Both the head and tail of each thinker list.
+thinker_t	thinkercaps[NUMTHINKERTYPES];
+
+// One pool per thinker type, all dropped by P_SetupLevel.
+arena_t		levelarena = { PU_LEVEL };
+
+pool_t		mobjpool = { sizeof(mobj_t), &levelarena };
+pool_t		ceilingpool = { sizeof(ceiling_t), &levelarena };
+pool_t		doorpool = { sizeof(vldoor_t), &levelarena };
+pool_t		floorpool = { sizeof(floormove_t), &levelarena };
+pool_t		platpool = { sizeof(plat_t), &levelarena };
+pool_t		flickerpool = { sizeof(fireflicker_t), &levelarena };
+pool_t		flashpool = { sizeof(lightflash_t), &levelarena };
+pool_t		strobepool = { sizeof(strobe_t), &levelarena };
+pool_t		glowpool = { sizeof(glow_t), &levelarena };
+
+// The pool of each thinkertype_t, and the function
+// its thinkers normally run.
+static struct
+{
+    pool_t*	pool;
+    actionf_p1	think;
+} thinkertypes[NUMTHINKERTYPES] =
+{
+    { &mobjpool,	(actionf_p1) P_MobjThinker },
+    { &ceilingpool,	(actionf_p1) T_MoveCeiling },
+    { &doorpool,	(actionf_p1) T_VerticalDoor },
+    { &floorpool,	(actionf_p1) T_MoveFloor },
+    { &platpool,	(actionf_p1) T_PlatRaise },
+    { &flickerpool,	(actionf_p1) T_FireFlicker },
+    { &flashpool,	(actionf_p1) T_LightFlash },
+    { &strobepool,	(actionf_p1) T_StrobeFlash },
+    { &glowpool,	(actionf_p1) T_Glow },
+};
+
+static int	thinkerseq;
 
 
 //
@@ -45,7 +80,12 @@ thinker_t	thinkercap;
 //
 void P_InitThinkers (void)
 {
-    thinkercap.prev = thinkercap.next  = &thinkercap;
+    int		i;
+
+    for (i=0 ; i<NUMTHINKERTYPES ; i++)
+	thinkercaps[i].prev = thinkercaps[i].next = &thinkercaps[i];
+
+    thinkerseq = 0;
 }
 
 
@@ -53,14 +93,32 @@ void P_InitThinkers (void)
 
 //
 // P_AddThinker
-// Adds a new thinker at the end of the list.
+// Adds a new thinker at the end of the list for its type,
+// which is told by the pool it was allocated from.
 //
 void P_AddThinker (thinker_t* thinker)
 {
-    thinkercap.prev->next = thinker;
-    thinker->next = &thinkercap;
-    thinker->prev = thinkercap.prev;
-    thinkercap.prev = thinker;
+    pool_t*	pool;
+    thinker_t*	cap;
+    int		i;
+
+    pool = Z_PoolOf (thinker);
+
+    for (i=0 ; i<NUMTHINKERTYPES ; i++)
+	if (thinkertypes[i].pool == pool)
+	    break;
+
+    if (i == NUMTHINKERTYPES)
+	I_Error ("P_AddThinker: thinker not from a thinker pool");
+
+    cap = &thinkercaps[i];
+
+    cap->prev->next = thinker;
+    thinker->next = cap;
+    thinker->prev = cap->prev;
+    cap->prev = thinker;
+
+    thinker->seq = thinkerseq++;
 }
 
 
@@ -88,29 +146,108 @@ void P_AllocateThinker (thinker_t*	thinker)
 
 
 
+//
+// P_Think
+// Runs a thinker of the given type, calling the usual
+// function for it directly.
+//
+static void P_Think (int type, thinker_t* th)
+{
+    if (th->function.acp1 != thinkertypes[type].think)
+    {
+	// in stasis, or something unusual
+	if (th->function.acp1)
+	    th->function.acp1 (th);
+	return;
+    }
+
+    switch (type)
+    {
+      case th_mobj:	P_MobjThinker ((mobj_t *) th);		break;
+      case th_ceiling:	T_MoveCeiling ((ceiling_t *) th);	break;
+      case th_door:	T_VerticalDoor ((vldoor_t *) th);	break;
+      case th_floor:	T_MoveFloor ((floormove_t *) th);	break;
+      case th_plat:	T_PlatRaise ((plat_t *) th);		break;
+      case th_flicker:	T_FireFlicker ((fireflicker_t *) th);	break;
+      case th_flash:	T_LightFlash ((lightflash_t *) th);	break;
+      case th_strobe:	T_StrobeFlash ((strobe_t *) th);	break;
+      case th_glow:	T_Glow ((glow_t *) th);			break;
+    }
+}
+
+
+
 //
 // P_RunThinkers
+// Runs every thinker in the order they were added, as one
+// list used to.  Thinkers of a type added one after another
+// (all the things of a level, say) are run as a batch along
+// their own list, up to the next thinker of any other type
+// or until something new is added.
 //
 void P_RunThinkers (void)
 {
-    thinker_t*	currentthinker;
+    thinker_t*	last[NUMTHINKERTYPES];	// last one run of each type
+    thinker_t*	th;
+    int		type;
+    int		limit;
+    int		seq;
+    int		i;
 
-    currentthinker = thinkercap.next;
-    while (currentthinker != &thinkercap)
+    for (i=0 ; i<NUMTHINKERTYPES ; i++)
+	last[i] = &thinkercaps[i];
+
+    while (1)
     {
-	if ( currentthinker->function.acv == (actionf_v)(-1) )
+	// the type of the earliest thinker still to run,
+	// and the seq of the one after it of any other type
+	type = -1;
+	limit = INT_MAX;
+
+	for (i=0 ; i<NUMTHINKERTYPES ; i++)
 	{
-	    // time to remove it
-	    currentthinker->next->prev = currentthinker->prev;
-	    currentthinker->prev->next = currentthinker->next;
-	    Z_Free (currentthinker);
+	    th = last[i]->next;
+
+	    if (th == &thinkercaps[i])
+		continue;
+
+	    if (type < 0 || th->seq < last[type]->next->seq)
+	    {
+		if (type >= 0)
+		    limit = last[type]->next->seq;
+		type = i;
+	    }
+	    else if (th->seq < limit)
+	    {
+		limit = th->seq;
+	    }
 	}
-	else
+
+	if (type < 0)
+	    break;
+
+	seq = thinkerseq;
+	th = last[type]->next;
+
+	do
 	{
-	    if (currentthinker->function.acp1)
-		currentthinker->function.acp1 (currentthinker);
-	}
-	currentthinker = currentthinker->next;
+	    if ( th->function.acv == (actionf_v)(-1) )
+	    {
+		// time to remove it
+		th->next->prev = th->prev;
+		th->prev->next = th->next;
+		Z_PoolFree (th);
+	    }
+	    else
+	    {
+		P_Think (type, th);
+		last[type] = th;
+	    }
+
+	    th = last[type]->next;
+	} while (th != &thinkercaps[type]
+		 && th->seq < limit
+		 && thinkerseq == seq);
     }
 }
 
@@ -138,6 +275,8 @@ void P_Ticker (void)
     }
     
 		
+    P_ClearSightCache ();
+
     for (i=0 ; i<MAXPLAYERS ; i++)
 	if (playeringame[i])
 	    P_PlayerThink (&players[i]);
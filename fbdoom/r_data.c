@@ -18,16 +18,22 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "z_zone.h"
 
 
+#include "m_config.h"
+#include "sha1.h"
+#include "w_checksum.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
+#include "m_argv.h"
 #include "m_misc.h"
 #include "r_local.h"
 #include "p_local.h"
@@ -110,14 +116,6 @@ struct texture_s
     short	width;
     short	height;
 
-    // Index in textures list
-
-    int         index;
-
-    // Next in hash table chain
-
-    texture_t  *next;
-    
     // All the patches[patchcount]
     //  are drawn back to front into the cached texture.
     short	patchcount;
@@ -140,7 +138,12 @@ int		numspritelumps;
 
 int		numtextures;
 texture_t**	textures;
-texture_t**     textures_hashtable;
+
+// Open addressed table of texture numbers keyed on the packed
+//  names in texturekeys (see W_LumpNameKey), -1 when empty.
+static int*		texturehash;
+static unsigned int	texturehashmask;
+static uint64_t*	texturekeys;
 
 
 int*			texturewidthmask;
@@ -151,6 +154,37 @@ short**			texturecolumnlump;
 unsigned short**	texturecolumnofs;
 byte**			texturecomposite;
 
+// Composites live in PU_STATIC blocks, out of reach of the
+//  Z_Malloc rover, and are evicted oldest first once their
+//  total goes over compositebudget bytes (-compositekb).
+int			compositebudget;
+int			compositebytes;
+int*			texturecompositeframe;	// last drawn, -1 if never drawn
+byte*			texturecompositebuilt;	// built at least once
+
+// just for profiling: columns of composite textures handed out
+//  without building, composites built, and of those the ones
+//  built again after an eviction or purge
+int			compositehits;
+int			compositemisses;
+int			compositerebuilds;
+int			compositeevictions;
+
+// Resolved column pointers, filled in as R_GetColumn is called.
+// A table is cleared whenever a purgable block has gone since
+//  it was stamped, as that may have been a patch or composite
+//  its entries point into.
+// The tables are purgable themselves.
+byte***			texturecolumncache;
+unsigned int*		texturecolumnstamp;
+
+// Set when something was built that the renderer snapshot
+//  file does not have, see R_WriteSnapshot.
+static boolean	snapshotstale;
+
+// tiled copies of the flats, see R_GenerateFlat
+byte**		flatcache;
+
 // for global animation
 int*		flattranslation;
 int*		texturetranslation;
@@ -217,6 +251,83 @@ R_DrawColumnInCache
 
 
 
+//
+// R_MakeCompositeRoom
+// Evicts the least recently drawn composites
+//  until size more bytes fit in the budget.
+//
+static void R_MakeCompositeRoom (int size)
+{
+    int		i;
+    int		oldest;
+
+    while (compositebytes + size > compositebudget)
+    {
+	oldest = -1;
+
+	for (i=0 ; i<numtextures ; i++)
+	{
+	    if (texturecomposite[i]
+		&& (oldest == -1
+		    || texturecompositeframe[i] < texturecompositeframe[oldest]))
+	    {
+		oldest = i;
+	    }
+	}
+
+	if (oldest == -1)
+	    break;
+
+	// clears texturecomposite[oldest]
+	Z_Free (texturecomposite[oldest]);
+	compositebytes -= texturecompositesize[oldest];
+	compositeevictions++;
+    }
+}
+
+
+
+//
+// R_ReleaseRegionData
+// Frees the composites and column lookups that were built in a
+//  region the zone grew by, so that Z_ReleaseRegions can hand
+//  the region back.  They are built again when next drawn.
+// Called between levels, when no column is held.
+//
+void R_ReleaseRegionData (void)
+{
+    int		i;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (texturecomposite[i]
+	 && (Z_InGrownRegion (texturecomposite[i])
+	     || Z_InGrownRegion (texturecolumnlump[i])
+	     || Z_InGrownRegion (texturecolumnofs[i])))
+	{
+	    // clears texturecomposite[i]
+	    Z_Free (texturecomposite[i]);
+	    compositebytes -= texturecompositesize[i];
+	}
+
+	if (texturecolumnlump[i]
+	 && (Z_InGrownRegion (texturecolumnlump[i])
+	     || Z_InGrownRegion (texturecolumnofs[i])))
+	{
+	    // the column table points through the lookup
+	    if (texturecolumncache[i])
+		Z_Free (texturecolumncache[i]);
+
+	    Z_Free (texturecolumnlump[i]);
+	    Z_Free (texturecolumnofs[i]);
+	    texturecolumnlump[i] = NULL;
+	    texturecolumnofs[i] = NULL;
+	}
+    }
+}
+
+
+
 //
 // R_GenerateComposite
 // Using the texture definition,
@@ -239,10 +350,22 @@ void R_GenerateComposite (int texnum)
 	
     texture = textures[texnum];
 
+    compositemisses++;
+
+    if (texturecompositebuilt[texnum])
+	compositerebuilds++;
+
+    texturecompositebuilt[texnum] = true;
+
+    R_MakeCompositeRoom (texturecompositesize[texnum]);
+
     block = Z_Malloc (texturecompositesize[texnum],
 		      PU_STATIC, 
 		      &texturecomposite[texnum]);	
 
+    compositebytes += texturecompositesize[texnum];
+    texturecompositeframe[texnum] = framecount;
+
     collump = texturecolumnlump[texnum];
     colofs = texturecolumnofs[texnum];
     
@@ -281,15 +404,16 @@ void R_GenerateComposite (int texnum)
 						
     }
 
-    // Now that the texture has been built in column cache,
-    //  it is purgable from zone memory.
-    Z_ChangeTag (block, PU_CACHE);
+    // The block stays PU_STATIC: only R_MakeCompositeRoom
+    //  frees composites, so hot ones survive unrelated loads.
 }
 
 
 
 //
 // R_GenerateLookup
+// Called for a texture when it is first drawn or precached,
+//  texturecolumnlump[texnum] is NULL until then.
 //
 void R_GenerateLookup (int texnum)
 {
@@ -310,8 +434,12 @@ void R_GenerateLookup (int texnum)
     texturecomposite[texnum] = 0;
     
     texturecompositesize[texnum] = 0;
-    collump = texturecolumnlump[texnum];
-    colofs = texturecolumnofs[texnum];
+    collump = texturecolumnlump[texnum] =
+	Z_Malloc (texture->width*sizeof(**texturecolumnlump), PU_STATIC,0);
+    colofs = texturecolumnofs[texnum] =
+	Z_Malloc (texture->width*sizeof(**texturecolumnofs), PU_STATIC,0);
+
+    snapshotstale = true;
     
     // Now count the number of columns
     //  that are covered by more than one patch.
@@ -376,6 +504,29 @@ void R_GenerateLookup (int texnum)
 
 
 
+//
+// R_TouchTexture
+// Columns handed out from texturecolumncache do not go through
+//  W_CacheLumpNum, so mark the patches and the table as used.
+//
+static void R_TouchTexture (int tex)
+{
+    texpatch_t*	patch;
+    int		i;
+
+    if (texturecolumncache[tex] != NULL)
+	Z_Touch (texturecolumncache[tex]);
+
+    patch = textures[tex]->patches;
+
+    for (i=0 ; i<textures[tex]->patchcount ; i++, patch++)
+    {
+	if (lumpinfo[patch->patch].cache != NULL)
+	    Z_Touch (lumpinfo[patch->patch].cache);
+    }
+}
+
+
 //
 // R_GetColumn
 //
@@ -386,62 +537,486 @@ R_GetColumn
 {
     int		lump;
     int		ofs;
+    int		size;
+    byte**	cache;
+    byte*	column;
+    unsigned int purges;
 	
     col &= texturewidthmask[tex];
+    cache = texturecolumncache[tex];
+    purges = Z_PurgeCount ();
+
+    // age for the composite cache, and keep the texture's
+    //  cached lumps from being purged while it is on screen
+    if (texturecompositeframe[tex] != framecount)
+    {
+	texturecompositeframe[tex] = framecount;
+	R_TouchTexture (tex);
+    }
+
+    if (cache != NULL && texturecolumnstamp[tex] == purges)
+    {
+	column = cache[col];
+
+	if (column != NULL)
+	{
+	    if (texturecolumnlump[tex][col] <= 0)
+		compositehits++;
+
+	    return column;
+	}
+    }
+    else
+    {
+	// (re)start the table for this texture
+	size = (texturewidthmask[tex]+1) * sizeof(*cache);
+
+	if (cache == NULL)
+	    cache = Z_Malloc (size, PU_CACHE, &texturecolumncache[tex]);
+
+	memset (cache, 0, size);
+	purges = Z_PurgeCount ();
+	texturecolumnstamp[tex] = purges;
+    }
+
+    // first use of the texture
+    if (texturecolumnlump[tex] == NULL)
+	R_GenerateLookup (tex);
+
     lump = texturecolumnlump[tex][col];
     ofs = texturecolumnofs[tex][col];
     
     if (lump > 0)
-	return (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
+	column = (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
+    else
+    {
+	if (texturecomposite[tex])
+	    compositehits++;
+	else
+	    R_GenerateComposite (tex);
+
+	column = texturecomposite[tex] + ofs;
+    }
 
-    if (!texturecomposite[tex])
-	R_GenerateComposite (tex);
+    // If loading it purged anything, the table may be stale,
+    //  or gone; the stamp no longer matches so it gets
+    //  cleared on the next call.
+    if (Z_PurgeCount () == purges)
+	cache[col] = column;
 
-    return texturecomposite[tex] + ofs;
+    return column;
 }
 
 
 static void GenerateTextureHashTable(void)
 {
-    texture_t **rover;
+    unsigned int size;
+    unsigned int slot;
     int i;
-    int key;
 
-    textures_hashtable 
-            = Z_Malloc(sizeof(texture_t *) * numtextures, PU_STATIC, 0);
+    // Keep the table at most half full.
+
+    for (size = 1; size < numtextures * 2; size <<= 1);
+
+    texturehash = Z_Malloc(sizeof(*texturehash) * size, PU_STATIC, 0);
+    memset(texturehash, -1, sizeof(*texturehash) * size);
+    texturehashmask = size - 1;
 
-    memset(textures_hashtable, 0, sizeof(texture_t *) * numtextures);
+    texturekeys = Z_Malloc(sizeof(*texturekeys) * numtextures, PU_STATIC, 0);
 
     // Add all textures to hash table
 
     for (i=0; i<numtextures; ++i)
     {
-        // Store index
-
-        textures[i]->index = i;
+        texturekeys[i] = W_LumpNameKey(textures[i]->name);
 
         // Vanilla Doom does a linear search of the texures array
         // and stops at the first entry it finds.  If there are two
         // entries with the same name, the first one in the array
-        // wins. The new entry must therefore be added at the end
-        // of the hash chain, so that earlier entries win.
+        // wins, so a name already in the table is left alone.
 
-        key = W_LumpNameHash(textures[i]->name) % numtextures;
+        slot = W_LumpKeyHash(texturekeys[i]) & texturehashmask;
 
-        rover = &textures_hashtable[key];
+        while (texturehash[slot] >= 0
+            && texturekeys[texturehash[slot]] != texturekeys[i])
+        {
+            slot = (slot + 1) & texturehashmask;
+        }
 
-        while (*rover != NULL)
+        if (texturehash[slot] < 0)
         {
-            rover = &(*rover)->next;
+            texturehash[slot] = i;
         }
+    }
+}
+
+
+//
+// RENDERER SNAPSHOT
+// R_GenerateLookup reads every patch of a texture and
+//  R_InitSpriteLumps every sprite, which takes seconds on slow
+//  boards.  What they found is saved to a file at exit and
+//  loaded on the next start when the WAD directories
+//  (W_Checksum), the texture definitions and the sizes and
+//  times of the WAD files have not changed.
+// The file holds the header, the sprite width and offset
+//  arrays, the composite sizes, a flag per texture telling
+//  whether its lookup was built, and the column lump and
+//  offset arrays of those textures, all in memory layout.
+//
+
+#define SNAPSHOT_VERSION	3
+
+typedef struct
+{
+    char		magic[8];
+    int			version;
+    sha1_digest_t	checksum;
+    int			numtextures;
+    int			totalwidth;	// of all textures
+    int			numspritelumps;
+    int			lookupwidth;	// of the textures with a lookup
+    int			length;
+} snapshot_t;
+
+static const char snapshot_magic[8] = "FBRTABS";
+
+// Contents of the snapshot file while R_InitData runs, or NULL.
+static snapshot_t*	snapshot;
+static boolean		snapshotloaded;
+static sha1_digest_t	snapshotchecksum;
+
+static int R_TotalTextureWidth (void)
+{
+    int		i;
+    int		total;
+
+    total = 0;
+
+    for (i=0 ; i<numtextures ; i++)
+	total += textures[i]->width;
+
+    return total;
+}
+
+static int R_SnapshotLength (int spritelumps, int lookupwidth)
+{
+    return sizeof(snapshot_t)
+	 + spritelumps * 3 * sizeof(fixed_t)
+	 + numtextures * sizeof(*texturecompositesize)
+	 + ((numtextures + 3) & ~3)
+	 + lookupwidth * (sizeof(**texturecolumnlump)
+			  + sizeof(**texturecolumnofs));
+}
+
+//
+// R_SnapshotName
+// The returned value must be freed with free() after use.
+//
+static char *R_SnapshotName (void)
+{
+    return M_StringJoin (configdir, "rtables.dat", NULL);
+}
 
-        // Hook into hash table
+//
+// R_SnapshotChecksum
+// The texture definitions are hashed as they are; the patches
+//  and sprites, too many to read at every start, through the
+//  files they come from.
+//
+static void R_SnapshotChecksum (sha1_digest_t digest)
+{
+    static char*	names[] = { "TEXTURE1", "TEXTURE2", "PNAMES" };
+    sha1_context_t	context;
+    sha1_digest_t	wads;
+    unsigned int	i;
+    int			lump;
+    int			length;
+
+    W_Checksum (wads);
 
-        textures[i]->next = NULL;
-        *rover = textures[i];
+    SHA1_Init (&context);
+    SHA1_Update (&context, wads, sizeof(wads));
+    W_ChecksumFiles (&context);
+
+    for (i=0 ; i<arrlen(names) ; i++)
+    {
+	lump = W_CheckNumForName (DEH_String (names[i]));
+
+	if (lump < 0)
+	{
+	    SHA1_UpdateInt32 (&context, -1);
+	    continue;
+	}
+
+	length = W_LumpLength (lump);
+	SHA1_UpdateInt32 (&context, length);
+	SHA1_Update (&context, W_CacheLumpNum (lump, PU_CACHE), length);
+	W_ReleaseLumpNum (lump);
     }
+
+    SHA1_Final (digest, &context);
 }
 
+//
+// R_ReadSnapshot
+// Loads the snapshot file if it belongs to the WADs in use.
+// The counts are checked against the texture and sprite lists
+//  as they are restored.
+//
+static void R_ReadSnapshot (void)
+{
+    char*	filename;
+    FILE*	handle;
+    long	length;
+
+    snapshot = NULL;
+
+    R_SnapshotChecksum (snapshotchecksum);
+
+    filename = R_SnapshotName ();
+    handle = fopen (filename, "rb");
+    free (filename);
+
+    if (handle == NULL)
+	return;
+
+    length = M_FileLength (handle);
+
+    if (length >= (long) sizeof(snapshot_t))
+    {
+	snapshot = Z_Malloc (length, PU_STATIC, NULL);
+
+	if (fread (snapshot, 1, length, handle) != (size_t) length
+	 || memcmp (snapshot->magic, snapshot_magic, sizeof(snapshot->magic))
+	 || snapshot->version != SNAPSHOT_VERSION
+	 || memcmp (snapshot->checksum, snapshotchecksum, sizeof(sha1_digest_t))
+	 || snapshot->length != length)
+	{
+	    Z_Free (snapshot);
+	    snapshot = NULL;
+	}
+    }
+
+    fclose (handle);
+}
+
+//
+// R_CheckLookups
+// True if the lookups in the snapshot, at p, cover exactly the
+//  textures flagged as built and point only into lumps and
+//  composites that exist.  Nothing is restored otherwise.
+//
+static boolean R_CheckLookups (int* sizes, byte* built, byte* p)
+{
+    texture_t*		texture;
+    short*		collump;
+    unsigned short*	colofs;
+    int			i;
+    int			x;
+    int			width;
+
+    width = 0;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (built[i] > 1 || sizes[i] < 0 || sizes[i] > 0x10000)
+	    return false;
+
+	if (built[i])
+	    width += textures[i]->width;
+    }
+
+    if (width != snapshot->lookupwidth)
+	return false;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!built[i])
+	    continue;
+
+	texture = textures[i];
+	collump = (short *) p;
+	p += texture->width * sizeof(*collump);
+	colofs = (unsigned short *) p;
+	p += texture->width * sizeof(*colofs);
+
+	for (x=0 ; x<texture->width ; x++)
+	{
+	    if (collump[x] == -1)
+	    {
+		if (colofs[x] + texture->height > sizes[i])
+		    return false;
+	    }
+	    else if (collump[x] < 0
+		  || collump[x] >= (int) numlumps
+		  || colofs[x] >= W_LumpLength (collump[x]))
+	    {
+		return false;
+	    }
+	}
+    }
+
+    return true;
+}
+
+//
+// R_RestoreLookups
+// Fills in the texture column lookups the snapshot has, as
+//  R_GenerateLookup would.
+//
+static boolean R_RestoreLookups (void)
+{
+    int*	sizes;
+    byte*	built;
+    byte*	p;
+    int		i;
+    int		width;
+
+    if (snapshot == NULL
+     || snapshot->numtextures != numtextures
+     || snapshot->totalwidth != R_TotalTextureWidth ()
+     || snapshot->length != R_SnapshotLength (snapshot->numspritelumps,
+					      snapshot->lookupwidth))
+    {
+	return false;
+    }
+
+    p = (byte *) (snapshot + 1)
+      + snapshot->numspritelumps * 3 * sizeof(fixed_t);
+
+    sizes = (int *) p;
+    p += numtextures * sizeof(*texturecompositesize);
+
+    built = p;
+    p += (numtextures + 3) & ~3;
+
+    if (!R_CheckLookups (sizes, built, p))
+	return false;
+
+    memcpy (texturecompositesize, sizes, numtextures * sizeof(*texturecompositesize));
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!built[i])
+	    continue;
+
+	width = textures[i]->width;
+	texturecomposite[i] = 0;
+
+	texturecolumnlump[i] = Z_Malloc (width*sizeof(**texturecolumnlump), PU_STATIC, 0);
+	texturecolumnofs[i] = Z_Malloc (width*sizeof(**texturecolumnofs), PU_STATIC, 0);
+
+	memcpy (texturecolumnlump[i], p, width * sizeof(**texturecolumnlump));
+	p += width * sizeof(**texturecolumnlump);
+	memcpy (texturecolumnofs[i], p, width * sizeof(**texturecolumnofs));
+	p += width * sizeof(**texturecolumnofs);
+    }
+
+    return true;
+}
+
+//
+// R_RestoreSpriteLumps
+//
+static boolean R_RestoreSpriteLumps (void)
+{
+    fixed_t*	p;
+
+    if (snapshot == NULL
+     || snapshot->numspritelumps != numspritelumps
+     || snapshot->numtextures != numtextures
+     || snapshot->length != R_SnapshotLength (snapshot->numspritelumps,
+					      snapshot->lookupwidth))
+    {
+	return false;
+    }
+
+    p = (fixed_t *) (snapshot + 1);
+
+    memcpy (spritewidth, p, numspritelumps * sizeof(fixed_t));
+    memcpy (spriteoffset, p + numspritelumps, numspritelumps * sizeof(fixed_t));
+    memcpy (spritetopoffset, p + numspritelumps*2, numspritelumps * sizeof(fixed_t));
+
+    return true;
+}
+
+//
+// R_WriteSnapshot
+// Called at exit, with whatever lookups the session built.
+//
+static void R_WriteSnapshot (void)
+{
+    snapshot_t*	out;
+    byte*	built;
+    byte*	p;
+    char*	filename;
+    int		lookupwidth;
+    int		length;
+    int		i;
+    int		width;
+
+    if (!snapshotstale)
+	return;
+
+    lookupwidth = 0;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (texturecolumnlump[i] != NULL)
+	    lookupwidth += textures[i]->width;
+    }
+
+    length = R_SnapshotLength (numspritelumps, lookupwidth);
+
+    out = Z_Malloc (length, PU_STATIC, NULL);
+    memset (out, 0, length);
+    memcpy (out->magic, snapshot_magic, sizeof(out->magic));
+    out->version = SNAPSHOT_VERSION;
+    memcpy (out->checksum, snapshotchecksum, sizeof(sha1_digest_t));
+    out->numtextures = numtextures;
+    out->totalwidth = R_TotalTextureWidth ();
+    out->numspritelumps = numspritelumps;
+    out->lookupwidth = lookupwidth;
+    out->length = length;
+
+    p = (byte *) (out + 1);
+
+    memcpy (p, spritewidth, numspritelumps * sizeof(fixed_t));
+    p += numspritelumps * sizeof(fixed_t);
+    memcpy (p, spriteoffset, numspritelumps * sizeof(fixed_t));
+    p += numspritelumps * sizeof(fixed_t);
+    memcpy (p, spritetopoffset, numspritelumps * sizeof(fixed_t));
+    p += numspritelumps * sizeof(fixed_t);
+
+    memcpy (p, texturecompositesize, numtextures * sizeof(*texturecompositesize));
+    p += numtextures * sizeof(*texturecompositesize);
+
+    built = p;
+    p += (numtextures + 3) & ~3;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (texturecolumnlump[i] == NULL)
+	    continue;
+
+	built[i] = 1;
+	width = textures[i]->width;
+
+	memcpy (p, texturecolumnlump[i], width * sizeof(**texturecolumnlump));
+	p += width * sizeof(**texturecolumnlump);
+	memcpy (p, texturecolumnofs[i], width * sizeof(**texturecolumnofs));
+	p += width * sizeof(**texturecolumnofs);
+    }
+
+    filename = R_SnapshotName ();
+    M_WriteFile (filename, out, length);
+    free (filename);
+
+    Z_Free (out);
+}
+
+
 
 //
 // R_InitTextures
@@ -523,6 +1098,33 @@ void R_InitTextures (void)
     texturecolumnlump = Z_Malloc (numtextures * sizeof(*texturecolumnlump), PU_STATIC, 0);
     texturecolumnofs = Z_Malloc (numtextures * sizeof(*texturecolumnofs), PU_STATIC, 0);
     texturecomposite = Z_Malloc (numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
+    memset (texturecomposite, 0, numtextures * sizeof(*texturecomposite));
+    texturecolumncache = Z_Malloc (numtextures * sizeof(*texturecolumncache), PU_STATIC, 0);
+    texturecolumnstamp = Z_Malloc (numtextures * sizeof(*texturecolumnstamp), PU_STATIC, 0);
+    memset (texturecolumncache, 0, numtextures * sizeof(*texturecolumncache));
+
+    texturecompositeframe = Z_Malloc (numtextures * sizeof(*texturecompositeframe), PU_STATIC, 0);
+    texturecompositebuilt = Z_Malloc (numtextures, PU_STATIC, 0);
+    memset (texturecompositebuilt, 0, numtextures);
+
+    for (i=0 ; i<numtextures ; i++)
+	texturecompositeframe[i] = -1;
+
+    //!
+    // @arg <kb>
+    //
+    // Budget for composite textures, in kilobytes.
+    // Defaults to an eighth of the zone.
+    //
+
+    i = M_CheckParmWithArgs ("-compositekb", 1);
+
+    if (i > 0)
+	compositebudget = atoi (myargv[i+1]) * 1024;
+    else
+	compositebudget = Z_ZoneSize () / 8;
+
+    compositebytes = 0;
     texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
     texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
     textureheight = Z_Malloc (numtextures * sizeof(*textureheight), PU_STATIC, 0);
@@ -592,8 +1194,9 @@ void R_InitTextures (void)
 			 texture->name);
 	    }
 	}		
-	texturecolumnlump[i] = Z_Malloc (texture->width*sizeof(**texturecolumnlump), PU_STATIC,0);
-	texturecolumnofs[i] = Z_Malloc (texture->width*sizeof(**texturecolumnofs), PU_STATIC,0);
+	// the column lookup is built on first use
+	texturecolumnlump[i] = NULL;
+	texturecolumnofs[i] = NULL;
 
 	j = 1;
 	while (j*2 <= texture->width)
@@ -611,10 +1214,8 @@ void R_InitTextures (void)
     if (maptex2)
         W_ReleaseLumpName(DEH_String("TEXTURE2"));
     
-    // Precalculate whatever possible.	
-
-    for (i=0 ; i<numtextures ; i++)
-	R_GenerateLookup (i);
+    if (!R_RestoreLookups ())
+	snapshotloaded = false;
     
     // Create translation table for global animation.
     texturetranslation = Z_Malloc ((numtextures+1)*sizeof(*texturetranslation), PU_STATIC, 0);
@@ -643,6 +1244,49 @@ void R_InitFlats (void)
     
     for (i=0 ; i<numflats ; i++)
 	flattranslation[i] = i;
+
+    flatcache = Z_Malloc (numflats*sizeof(*flatcache), PU_STATIC, 0);
+    memset (flatcache, 0, numflats*sizeof(*flatcache));
+}
+
+
+
+//
+// R_GenerateFlat
+// The span drawers do not read the raw lump, but a copy
+//  laid out as 8x8 tiles of 8x8 texels (see FLATTILE),
+//  so a span crossing the flat at a steep angle stays
+//  within a few cache lines instead of one per texel.
+//
+void R_GenerateFlat (int flat)
+{
+    byte*	block;
+    byte*	raw;
+    int		x;
+    int		y;
+
+    block = Z_Malloc (64*64, PU_STATIC, &flatcache[flat]);
+    raw = W_CacheLumpNum (firstflat + flat, PU_CACHE);
+
+    for (y=0 ; y<64 ; y++)
+	for (x=0 ; x<64 ; x++)
+	    block[FLATTILE(x, y)] = raw[(y<<6) + x];
+
+    // Like composites, the copy can be rebuilt when purged.
+    Z_ChangeTag (block, PU_CACHE);
+}
+
+
+//
+// R_GetFlat
+// Returns the tiled copy of a flat, for ds_source.
+//
+byte* R_GetFlat (int flat)
+{
+    if (!flatcache[flat])
+	R_GenerateFlat (flat);
+
+    return flatcache[flat];
 }
 
 
@@ -664,6 +1308,18 @@ void R_InitSpriteLumps (void)
     spritewidth = Z_Malloc (numspritelumps*sizeof(*spritewidth), PU_STATIC, 0);
     spriteoffset = Z_Malloc (numspritelumps*sizeof(*spriteoffset), PU_STATIC, 0);
     spritetopoffset = Z_Malloc (numspritelumps*sizeof(*spritetopoffset), PU_STATIC, 0);
+
+    if (R_RestoreSpriteLumps ())
+    {
+	// keep the startup box filling up as before
+	for (i=0 ; i< numspritelumps ; i+=64)
+	    printf (".");
+
+	return;
+    }
+
+    snapshotloaded = false;
+    snapshotstale = true;
 	
     for (i=0 ; i< numspritelumps ; i++)
     {
@@ -702,13 +1358,53 @@ void R_InitColormaps (void)
 //
 void R_InitData (void)
 {
+    int		starttime;
+    int		texturetime;
+    int		spritetime;
+    int		endtime;
+
+    starttime = I_GetTimeMS ();
+    snapshot = NULL;
+    snapshotstale = false;
+
+    //!
+    // Do not load or save the snapshot of the renderer tables.
+    //
+
+    if (!M_CheckParm ("-nosnapshot"))
+    {
+	R_ReadSnapshot ();
+	I_AtExit (R_WriteSnapshot, false);
+    }
+
+    snapshotloaded = snapshot != NULL;
+
     R_InitTextures ();
     printf (".");
+    texturetime = I_GetTimeMS ();
     R_InitFlats ();
     printf (".");
+    spritetime = I_GetTimeMS ();
     R_InitSpriteLumps ();
     printf (".");
+    endtime = I_GetTimeMS ();
     R_InitColormaps ();
+
+    if (snapshot != NULL)
+    {
+	Z_Free (snapshot);
+	snapshot = NULL;
+    }
+
+    if (devparm)
+    {
+	printf ("\nR_InitData: textures %i ms, sprites %i ms, total %i ms"
+		" (%s)\n",
+		texturetime - starttime,
+		endtime - spritetime,
+		I_GetTimeMS () - starttime,
+		snapshotloaded ? "snapshot" : "no snapshot");
+    }
 }
 
 
@@ -743,23 +1439,23 @@ int R_FlatNumForName (char* name)
 //
 int	R_CheckTextureNumForName (char *name)
 {
-    texture_t *texture;
-    int key;
+    uint64_t		key;
+    unsigned int	slot;
+    int			i;
 
     // "NoTexture" marker.
     if (name[0] == '-')		
 	return 0;
 		
-    key = W_LumpNameHash(name) % numtextures;
+    key = W_LumpNameKey (name);
+    slot = W_LumpKeyHash (key) & texturehashmask;
 
-    texture=textures_hashtable[key]; 
-    
-    while (texture != NULL)
+    for (i = texturehash[slot] ; i >= 0 ; i = texturehash[slot])
     {
-	if (!strncasecmp (texture->name, name, 8) )
-	    return texture->index;
+	if (texturekeys[i] == key)
+	    return i;
 
-        texture = texture->next;
+	slot = (slot + 1) & texturehashmask;
     }
     
     return -1;
@@ -767,6 +1463,21 @@ int	R_CheckTextureNumForName (char *name)
 
 
 
+//
+// R_TexturePatchLump
+// Lump number of one of the patches making up a texture,
+//  or -1 past the last one.  Used by the level prefetch.
+//
+int R_TexturePatchLump (int tex, int patch)
+{
+    if (patch >= textures[tex]->patchcount)
+	return -1;
+
+    return textures[tex]->patches[patch].patch;
+}
+
+
+
 //
 // R_TextureNumForName
 // Calls R_CheckTextureNumForName,
@@ -812,6 +1523,15 @@ void R_PrecacheLevel (void)
     thinker_t*		th;
     spriteframe_t*	sf;
 
+    // composite cache use over the previous levels
+    if (devparm)
+    {
+	printf ("R_PrecacheLevel: composites %i/%i bytes, %i hits, "
+		"%i misses, %i rebuilds, %i evictions\n",
+		compositebytes, compositebudget, compositehits,
+		compositemisses, compositerebuilds, compositeevictions);
+    }
+
     if (demoplayback)
 	return;
     
@@ -833,7 +1553,7 @@ void R_PrecacheLevel (void)
 	{
 	    lump = firstflat + i;
 	    flatmemory += lumpinfo[lump].size;
-	    W_CacheLumpNum(lump, PU_CACHE);
+	    R_GetFlat (i);
 	}
     }
 
@@ -865,6 +1585,9 @@ void R_PrecacheLevel (void)
 	    continue;
 
 	texture = textures[i];
+
+	if (texturecolumnlump[i] == NULL)
+	    R_GenerateLookup (i);
 	
 	for (j=0 ; j<texture->patchcount ; j++)
 	{
@@ -880,7 +1603,9 @@ void R_PrecacheLevel (void)
     spritepresent = Z_Malloc(numsprites, PU_STATIC, NULL);
     memset (spritepresent,0, numsprites);
 	
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    for (th = thinkercaps[th_mobj].next ;
+	 th != &thinkercaps[th_mobj] ;
+	 th = th->next)
     {
 	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 	    spritepresent[((mobj_t *)th)->sprite] = 1;
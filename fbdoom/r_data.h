@@ -32,9 +32,19 @@ R_GetColumn
   int		col );
 
 
+// Offset of texel (x, y) in a flat returned by R_GetFlat:
+//  8x8 tiles of 8x8 texels, each tile one 64 byte run.
+#define FLATTILE(x, y)	((((y) & 0x38) << 6) | (((x) & 0x38) << 3)	\
+			 | (((y) & 7) << 3) | ((x) & 7))
+
+// Retrieve a tiled flat for span blitting.
+byte* R_GetFlat (int flat);
+
+
 // I/O, setting up the stuff.
 void R_InitData (void);
 void R_PrecacheLevel (void);
+void R_ReleaseRegionData (void);
 
 
 // Retrieval.
@@ -47,5 +57,6 @@ int R_FlatNumForName (char* name);
 // returns the texture number for the texture name.
 int R_TextureNumForName (char *name);
 int R_CheckTextureNumForName (char *name);
+int R_TexturePatchLump (int tex, int patch);
 
 #endif
@@ -63,6 +63,16 @@ int		viewwindowy;
 byte*		ylookup[MAXHEIGHT]; 
 int		columnofs[MAXWIDTH]; 
 
+// Distance from a view pixel to the one below it,
+//  and to the one on its right.
+int		dc_pitch = SCREENWIDTH;
+int		ds_pitch = 1;
+
+// If true, the view is drawn column-major into its own buffer,
+//  see R_InitBuffer and R_TransposeView.
+boolean		transposedview;
+static byte*	transposed_buffer = NULL;
+
 // Color tables for different players,
 //  translate a limited part to another
 //  (color ramps used for  suit colors).
@@ -103,6 +113,7 @@ void R_DrawColumn (void)
 { 
     int			count; 
     byte*		dest; 
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
  
@@ -123,6 +134,7 @@ void R_DrawColumn (void)
     // Use ylookup LUT to avoid multiply with ScreenWidth.
     // Use columnofs LUT for subwindows? 
     dest = ylookup[dc_yl] + columnofs[dc_x];  
+    pitch = dc_pitch;
 
     // Determine scaling,
     //  which is the only mapping to be done.
@@ -138,7 +150,7 @@ void R_DrawColumn (void)
 	//  using a lighting/special effects LUT.
 	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
 	
-	dest += SCREENWIDTH; 
+	dest += pitch; 
 	frac += fracstep;
 	
     } while (count--); 
@@ -146,6 +158,218 @@ void R_DrawColumn (void)
 
 
 
+//
+// R_DrawColumnFast
+// Same output as R_DrawColumn, split by how the
+//  column walks its texture:
+// - runs that stay inside the first 128 texels,
+//   which is nearly every wall, need no wrapping and
+//   go through an unmasked loop unrolled by four;
+// - anything else wraps with the power of two
+//   mask R_DrawColumn always applies.
+//
+void R_DrawColumnFast (void)
+{
+    int			count;
+    byte*		dest;
+    int			pitch;
+    byte*		source;
+    byte*		colormap;
+    fixed_t		frac;
+    fixed_t		fracstep;
+    int64_t		last;
+
+    count = dc_yh - dc_yl;
+
+    // Zero length, column does not exceed a pixel.
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumnFast: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[dc_x];
+    pitch = dc_pitch;
+    source = dc_source;
+    colormap = dc_colormap;
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    // texel row of the last pixel, without 32-bit wrapping
+    last = (int64_t) frac + (int64_t) count * fracstep;
+
+    if (frac >= 0 && fracstep >= 0 && last < (128<<FRACBITS))
+    {
+	count++;
+
+	while (count >= 4)
+	{
+	    dest[0] = colormap[source[frac>>FRACBITS]];
+	    frac += fracstep;
+	    dest[pitch] = colormap[source[frac>>FRACBITS]];
+	    frac += fracstep;
+	    dest[pitch*2] = colormap[source[frac>>FRACBITS]];
+	    frac += fracstep;
+	    dest[pitch*3] = colormap[source[frac>>FRACBITS]];
+	    frac += fracstep;
+
+	    dest += pitch*4;
+	    count -= 4;
+	}
+
+	while (count--)
+	{
+	    *dest = colormap[source[frac>>FRACBITS]];
+	    dest += pitch;
+	    frac += fracstep;
+	}
+
+	return;
+    }
+
+    do
+    {
+	*dest = colormap[source[(frac>>FRACBITS)&127]];
+	dest += pitch;
+	frac += fracstep;
+    } while (count--);
+}
+
+
+
+//
+// R_DrawColumnQuad
+// Draws the four adjacent columns dc_x..dc_x+3, which share
+//  dc_source texture and dc_colormap, but each have their own
+//  top, bottom and scale.
+// The rows all four columns cover are written a row at a time,
+//  touching one cache line per row instead of four;
+//  the ragged ends are drawn column by column.
+// Output is identical to four R_DrawColumn calls.
+//
+int			dc_quadyl[QUADCOLUMNS];
+int			dc_quadyh[QUADCOLUMNS];
+fixed_t			dc_quadiscale[QUADCOLUMNS];
+byte*			dc_quadsource[QUADCOLUMNS];
+
+void R_DrawColumnQuad (void)
+{
+    int			i;
+    int			y;
+    int			top;
+    int			bottom;
+    byte*		dest;
+    byte*		colormap;
+    byte*		source;
+    unsigned		frac[QUADCOLUMNS];
+    unsigned		fracstep;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x > SCREENWIDTH - QUADCOLUMNS)
+	I_Error ("R_DrawColumnQuad: %i", dc_x);
+
+    for (i=0 ; i<QUADCOLUMNS ; i++)
+    {
+	if (dc_quadyl[i] <= dc_quadyh[i]
+	    && (dc_quadyl[i] < 0 || dc_quadyh[i] >= SCREENHEIGHT))
+	{
+	    I_Error ("R_DrawColumnQuad: %i to %i at %i",
+		     dc_quadyl[i], dc_quadyh[i], dc_x+i);
+	}
+    }
+#endif
+
+    // rows shared by all four columns
+    top = dc_quadyl[0];
+    bottom = dc_quadyh[0];
+
+    for (i=1 ; i<QUADCOLUMNS ; i++)
+    {
+	if (dc_quadyl[i] > top)
+	    top = dc_quadyl[i];
+	if (dc_quadyh[i] < bottom)
+	    bottom = dc_quadyh[i];
+    }
+
+    colormap = dc_colormap;
+
+    // Unsigned so the stepping wraps exactly like
+    //  the incremental frac in R_DrawColumn.
+    for (i=0 ; i<QUADCOLUMNS ; i++)
+    {
+	frac[i] = (unsigned) dc_texturemid
+		+ (unsigned) (dc_quadyl[i]-centery) * (unsigned) dc_quadiscale[i];
+    }
+
+    if (top > bottom)
+    {
+	// nothing in common, draw them one by one
+	top = SCREENHEIGHT;
+	bottom = SCREENHEIGHT-1;
+    }
+
+    // heads, above the shared rows
+    for (i=0 ; i<QUADCOLUMNS ; i++)
+    {
+	if (dc_quadyl[i] >= top || dc_quadyl[i] > dc_quadyh[i])
+	    continue;
+
+	source = dc_quadsource[i];
+	fracstep = dc_quadiscale[i];
+	dest = ylookup[dc_quadyl[i]] + columnofs[dc_x+i];
+
+	for (y=dc_quadyl[i] ; y<top && y<=dc_quadyh[i] ; y++)
+	{
+	    *dest = colormap[source[(frac[i]>>FRACBITS)&127]];
+	    dest += SCREENWIDTH;
+	    frac[i] += fracstep;
+	}
+    }
+
+    // body, a row at a time
+    for (y=top ; y<=bottom ; y++)
+    {
+	dest = ylookup[y] + columnofs[dc_x];
+
+	dest[0] = colormap[dc_quadsource[0][(frac[0]>>FRACBITS)&127]];
+	dest[1] = colormap[dc_quadsource[1][(frac[1]>>FRACBITS)&127]];
+	dest[2] = colormap[dc_quadsource[2][(frac[2]>>FRACBITS)&127]];
+	dest[3] = colormap[dc_quadsource[3][(frac[3]>>FRACBITS)&127]];
+
+	frac[0] += dc_quadiscale[0];
+	frac[1] += dc_quadiscale[1];
+	frac[2] += dc_quadiscale[2];
+	frac[3] += dc_quadiscale[3];
+    }
+
+    // tails, below the shared rows
+    for (i=0 ; i<QUADCOLUMNS ; i++)
+    {
+	y = bottom+1;
+
+	if (y > dc_quadyh[i])
+	    continue;
+
+	source = dc_quadsource[i];
+	fracstep = dc_quadiscale[i];
+	dest = ylookup[y] + columnofs[dc_x+i];
+
+	for ( ; y<=dc_quadyh[i] ; y++)
+	{
+	    *dest = colormap[source[(frac[i]>>FRACBITS)&127]];
+	    dest += SCREENWIDTH;
+	    frac[i] += fracstep;
+	}
+    }
+}
+
+
+
 // UNUSED.
 // Loop unrolled.
 #if 0
@@ -210,6 +434,7 @@ void R_DrawColumnLow (void)
     int			count; 
     byte*		dest; 
     byte*		dest2;
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
     int                 x;
@@ -235,6 +460,7 @@ void R_DrawColumnLow (void)
     
     dest = ylookup[dc_yl] + columnofs[x];
     dest2 = ylookup[dc_yl] + columnofs[x+1];
+    pitch = dc_pitch;
     
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep;
@@ -243,8 +469,8 @@ void R_DrawColumnLow (void)
     {
 	// Hack. Does not work corretly.
 	*dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += pitch;
+	dest2 += pitch;
 	frac += fracstep; 
 
     } while (count--);
@@ -284,6 +510,7 @@ void R_DrawFuzzColumn (void)
 { 
     int			count; 
     byte*		dest; 
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
 
@@ -311,6 +538,7 @@ void R_DrawFuzzColumn (void)
 #endif
     
     dest = ylookup[dc_yl] + columnofs[dc_x];
+    pitch = dc_pitch;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -331,7 +559,7 @@ void R_DrawFuzzColumn (void)
 	if (++fuzzpos == FUZZTABLE) 
 	    fuzzpos = 0;
 	
-	dest += SCREENWIDTH;
+	dest += pitch;
 
 	frac += fracstep; 
     } while (count--); 
@@ -344,6 +572,7 @@ void R_DrawFuzzColumnLow (void)
     int			count; 
     byte*		dest; 
     byte*		dest2; 
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
     int x;
@@ -377,6 +606,7 @@ void R_DrawFuzzColumnLow (void)
     
     dest = ylookup[dc_yl] + columnofs[x];
     dest2 = ylookup[dc_yl] + columnofs[x+1];
+    pitch = dc_pitch;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -398,8 +628,8 @@ void R_DrawFuzzColumnLow (void)
 	if (++fuzzpos == FUZZTABLE) 
 	    fuzzpos = 0;
 	
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += pitch;
+	dest2 += pitch;
 
 	frac += fracstep; 
     } while (count--); 
@@ -425,6 +655,7 @@ void R_DrawTranslatedColumn (void)
 { 
     int			count; 
     byte*		dest; 
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
  
@@ -445,6 +676,7 @@ void R_DrawTranslatedColumn (void)
 
 
     dest = ylookup[dc_yl] + columnofs[dc_x]; 
+    pitch = dc_pitch;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -459,7 +691,7 @@ void R_DrawTranslatedColumn (void)
 	// Thus the "green" ramp of the player 0 sprite
 	//  is mapped to gray, red, black/indigo. 
 	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-	dest += SCREENWIDTH;
+	dest += pitch;
 	
 	frac += fracstep; 
     } while (count--); 
@@ -470,6 +702,7 @@ void R_DrawTranslatedColumnLow (void)
     int			count; 
     byte*		dest; 
     byte*		dest2; 
+    int			pitch;
     fixed_t		frac;
     fixed_t		fracstep;	 
     int                 x;
@@ -495,6 +728,7 @@ void R_DrawTranslatedColumnLow (void)
 
     dest = ylookup[dc_yl] + columnofs[x]; 
     dest2 = ylookup[dc_yl] + columnofs[x+1]; 
+    pitch = dc_pitch;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -510,8 +744,8 @@ void R_DrawTranslatedColumnLow (void)
 	//  is mapped to gray, red, black/indigo. 
 	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
 	*dest2 = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += pitch;
+	dest2 += pitch;
 	
 	frac += fracstep; 
     } while (count--); 
@@ -591,6 +825,7 @@ void R_DrawSpan (void)
 { 
     unsigned int position, step;
     byte *dest;
+    int pitch;
     int count;
     int spot;
     unsigned int xtemp, ytemp;
@@ -618,6 +853,7 @@ void R_DrawSpan (void)
          | ((ds_ystep >> 6)  & 0x0000ffff);
 
     dest = ylookup[ds_y] + columnofs[ds_x1];
+    pitch = ds_pitch;
 
     // We do not check for zero spans here?
     count = ds_x2 - ds_x1;
@@ -625,13 +861,14 @@ void R_DrawSpan (void)
     do
     {
 	// Calculate current texture index in u,v.
-        ytemp = (position >> 4) & 0x0fc0;
+        ytemp = (position >> 10) & 63;
         xtemp = (position >> 26);
-        spot = xtemp | ytemp;
+        spot = FLATTILE(xtemp, ytemp);
 
 	// Lookup pixel from flat texture tile,
 	//  re-index using light/colormap.
-	*dest++ = ds_colormap[ds_source[spot]];
+	*dest = ds_colormap[ds_source[spot]];
+	dest += pitch;
 
         position += step;
 
@@ -639,6 +876,81 @@ void R_DrawSpan (void)
 }
 
 
+//
+// R_DrawSpanFast
+// Same output as R_DrawSpan, but works through the span
+//  eight pixels at a time: the eight texel addresses are
+//  computed together first, in a loop with no dependencies
+//  between lanes that the compiler can vectorize,
+//  then fetched and written.
+//
+#define SPANBLOCK		8
+
+void R_DrawSpanFast (void)
+{
+    unsigned int	position;
+    unsigned int	step;
+    unsigned int	spot[SPANBLOCK];
+    byte*		dest;
+    byte*		source;
+    byte*		colormap;
+    int			pitch;
+    int			count;
+    int			i;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpanFast: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    // same packed 6.10:6.10 position as R_DrawSpan
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    pitch = ds_pitch;
+    source = ds_source;
+    colormap = ds_colormap;
+
+    count = ds_x2 - ds_x1 + 1;
+
+    while (count >= SPANBLOCK)
+    {
+	for (i=0 ; i<SPANBLOCK ; i++)
+	{
+	    unsigned int p = position + i*step;
+
+	    spot[i] = FLATTILE(p >> 26, (p >> 10) & 63);
+	}
+
+	for (i=0 ; i<SPANBLOCK ; i++)
+	{
+	    *dest = colormap[source[spot[i]]];
+	    dest += pitch;
+	}
+
+	position += SPANBLOCK*step;
+	count -= SPANBLOCK;
+    }
+
+    while (count--)
+    {
+	*dest = colormap[source[FLATTILE(position >> 26,
+					 (position >> 10) & 63)]];
+	dest += pitch;
+	position += step;
+    }
+}
+
+
 
 // UNUSED.
 // Loop unrolled by 4.
@@ -721,6 +1033,7 @@ void R_DrawSpanLow (void)
     unsigned int position, step;
     unsigned int xtemp, ytemp;
     byte *dest;
+    int pitch;
     int count;
     int spot;
 
@@ -748,18 +1061,20 @@ void R_DrawSpanLow (void)
     ds_x2 <<= 1;
 
     dest = ylookup[ds_y] + columnofs[ds_x1];
+    pitch = ds_pitch;
 
     do
     {
 	// Calculate current texture index in u,v.
-        ytemp = (position >> 4) & 0x0fc0;
+        ytemp = (position >> 10) & 63;
         xtemp = (position >> 26);
-        spot = xtemp | ytemp;
+        spot = FLATTILE(xtemp, ytemp);
 
 	// Lowres/blocky mode does it twice,
 	//  while scale is adjusted appropriately.
-	*dest++ = ds_colormap[ds_source[spot]];
-	*dest++ = ds_colormap[ds_source[spot]];
+	dest[0] = ds_colormap[ds_source[spot]];
+	dest[pitch] = ds_colormap[ds_source[spot]];
+	dest += pitch*2;
 
 	position += step;
 
@@ -798,7 +1113,69 @@ R_InitBuffer
     // Preclaculate all row offsets.
     for (i=0 ; i<height ; i++) 
 	ylookup[i] = I_VideoBuffer + (i+viewwindowy)*SCREENWIDTH; 
+
+    dc_pitch = SCREENWIDTH;
+    ds_pitch = 1;
+
+    if (transposedview)
+    {
+	// Each view column is stored contiguously,
+	//  so the column drawers write sequential bytes
+	//  and the span drawers step by the view height.
+	if (transposed_buffer == NULL)
+	{
+	    transposed_buffer = Z_Malloc (SCREENWIDTH*SCREENHEIGHT,
+					  PU_STATIC, NULL);
+	}
+
+	for (i=0 ; i<width ; i++)
+	    columnofs[i] = i*height;
+
+	for (i=0 ; i<height ; i++)
+	    ylookup[i] = transposed_buffer + i;
+
+	dc_pitch = 1;
+	ds_pitch = height;
+    }
+
+    // The fuzz effect reads the pixels above and below.
+    for (i=0 ; i<FUZZTABLE ; i++)
+	fuzzoffset[i] = fuzzoffset[i] > 0 ? dc_pitch : -dc_pitch;
 } 
+
+
+//
+// R_TransposeView
+// Copies a column-major view into the screen buffer.
+// Done in strips of eight rows, so each source column
+//  is read eight bytes at a time.
+//
+void R_TransposeView (void)
+{
+    byte*	src;
+    byte*	dest;
+    int		x;
+    int		y;
+    int		y2;
+    int		i;
+
+    if (!transposedview)
+	return;
+
+    for (y=0 ; y<viewheight ; y+=8)
+    {
+	y2 = y+8 < viewheight ? y+8 : viewheight;
+	dest = I_VideoBuffer + (y+viewwindowy)*SCREENWIDTH + viewwindowx;
+
+	for (x=0 ; x<scaledviewwidth ; x++)
+	{
+	    src = transposed_buffer + x*viewheight;
+
+	    for (i=y ; i<y2 ; i++)
+		dest[(i-y)*SCREENWIDTH + x] = src[i];
+	}
+    }
+}
  
  
 
@@ -34,11 +34,28 @@ extern fixed_t		dc_texturemid;
 extern byte*		dc_source;		
 
 
+extern int		dc_pitch;
+extern int		ds_pitch;
+
+extern boolean		transposedview;
+
+// Four adjacent columns for R_DrawColumnQuad,
+//  starting at dc_x.
+#define QUADCOLUMNS		4
+
+extern int		dc_quadyl[QUADCOLUMNS];
+extern int		dc_quadyh[QUADCOLUMNS];
+extern fixed_t		dc_quadiscale[QUADCOLUMNS];
+extern byte*		dc_quadsource[QUADCOLUMNS];
+
+
 // The span blitting interface.
 // Hook in assembler or system specific BLT
 //  here.
 void 	R_DrawColumn (void);
+void 	R_DrawColumnFast (void);
 void 	R_DrawColumnLow (void);
+void 	R_DrawColumnQuad (void);
 
 // The Spectre/Invisibility effect.
 void 	R_DrawFuzzColumn (void);
@@ -66,7 +83,7 @@ extern fixed_t		ds_yfrac;
 extern fixed_t		ds_xstep;
 extern fixed_t		ds_ystep;
 
-// start of a 64*64 tile image
+// start of a 64*64 tiled flat, see R_GetFlat
 extern byte*		ds_source;		
 
 extern byte*		translationtables;
@@ -76,6 +93,7 @@ extern byte*		dc_translation;
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
 void 	R_DrawSpan (void);
+void 	R_DrawSpanFast (void);
 
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
@@ -93,6 +111,9 @@ void	R_InitTranslationTables (void);
 
 
 
+// Copies a column-major view to the screen.
+void R_TransposeView (void);
+
 // Rendering function.
 void R_FillBackScreen (void);
 
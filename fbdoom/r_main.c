@@ -29,6 +29,7 @@
 #include "doomdef.h"
 #include "d_loop.h"
 
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_menu.h"
 
@@ -697,10 +698,12 @@ void R_ExecuteSetViewSize (void)
 
     if (!detailshift)
     {
-	colfunc = basecolfunc = R_DrawColumn;
+	// The fast drawers give the same pixels as
+	//  R_DrawColumn and R_DrawSpan.
+	colfunc = basecolfunc = R_DrawColumnFast;
 	fuzzcolfunc = R_DrawFuzzColumn;
 	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
+	spanfunc = R_DrawSpanFast;
     }
     else
     {
@@ -774,6 +777,14 @@ void R_Init (void)
     // viewwidth / viewheight / detailLevel are set by the defaults
     printf (".");
 
+    //!
+    // Render the 3D view column-major, so that wall and sprite
+    // columns are written sequentially, and transpose it into
+    // the screen once the view is done.
+    //
+
+    transposedview = M_CheckParm ("-colmajor") > 0;
+
     R_SetViewSize (screenblocks, detailLevel);
     R_InitPlanes ();
     printf (".");
@@ -886,6 +897,8 @@ void R_RenderPlayerView (player_t* player)
     
     R_DrawMasked ();
 
+    R_TransposeView ();
+
     // Check for new console commands.
     NetUpdate ();				
 }
@@ -46,6 +46,9 @@ extern fixed_t		projection;
 
 extern int		validcount;
 
+// frames rendered so far
+extern int		framecount;
+
 extern int		linecount;
 extern int		loopcount;
 
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "doomstat.h"
@@ -196,6 +197,153 @@ R_RenderMaskedSegRange
 #define HEIGHTBITS		12
 #define HEIGHTUNIT		(1<<HEIGHTBITS)
 
+//
+// Wall column batches.
+// Each wall tier queues its columns instead of drawing them
+//  straight away, so runs of QUADCOLUMNS adjacent columns
+//  with the same texture and light can go through
+//  R_DrawColumnQuad. Anything else is drawn one column
+//  at a time, as before.
+//
+typedef struct
+{
+    int			count;
+    int			x;		// first column of the run
+    int			texnum;
+    fixed_t		texturemid;
+    lighttable_t*	colormap;
+
+    int			yl[QUADCOLUMNS];
+    int			yh[QUADCOLUMNS];
+    fixed_t		iscale[QUADCOLUMNS];
+    int			texturecolumn[QUADCOLUMNS];
+} wallbatch_t;
+
+static wallbatch_t	topbatch;
+static wallbatch_t	midbatch;
+static wallbatch_t	bottombatch;
+
+
+static void R_FlushWallBatch (wallbatch_t* b)
+{
+    unsigned int	purges;
+    int			i;
+    int			x;
+    lighttable_t*	colormap;
+    fixed_t		iscale;
+
+    if (!b->count)
+	return;
+
+    // R_RenderSegLoop keeps the current column in these
+    x = dc_x;
+    colormap = dc_colormap;
+    iscale = dc_iscale;
+
+    // Fetching a column can load a patch or build a composite,
+    //  and that may purge the block an earlier column of
+    //  the run points into.
+    purges = Z_PurgeCount ();
+
+    for (i=0 ; i<b->count ; i++)
+	dc_quadsource[i] = R_GetColumn (b->texnum, b->texturecolumn[i]);
+
+    dc_colormap = b->colormap;
+    dc_texturemid = b->texturemid;
+
+    if (b->count == QUADCOLUMNS && Z_PurgeCount () == purges)
+    {
+	dc_x = b->x;
+
+	for (i=0 ; i<QUADCOLUMNS ; i++)
+	{
+	    dc_quadyl[i] = b->yl[i];
+	    dc_quadyh[i] = b->yh[i];
+	    dc_quadiscale[i] = b->iscale[i];
+	}
+
+	R_DrawColumnQuad ();
+    }
+    else
+    {
+	for (i=0 ; i<b->count ; i++)
+	{
+	    dc_x = b->x + i;
+	    dc_yl = b->yl[i];
+	    dc_yh = b->yh[i];
+	    dc_iscale = b->iscale[i];
+
+	    if (Z_PurgeCount () != purges)
+		dc_source = R_GetColumn (b->texnum, b->texturecolumn[i]);
+	    else
+		dc_source = dc_quadsource[i];
+
+	    colfunc ();
+	}
+    }
+
+    b->count = 0;
+
+    dc_x = x;
+    dc_colormap = colormap;
+    dc_iscale = iscale;
+}
+
+
+//
+// R_QueueWallColumn
+// Queues column rw_x of a wall tier,
+//  using the current dc_colormap and dc_iscale.
+//
+static void
+R_QueueWallColumn
+( wallbatch_t*	b,
+  int		texnum,
+  fixed_t	texturemid,
+  int		texturecolumn,
+  int		yl,
+  int		yh )
+{
+    int		i;
+
+    // the batch drawer only exists in full detail,
+    //  and only pays off when rows are contiguous
+    if (detailshift || transposedview)
+    {
+	dc_yl = yl;
+	dc_yh = yh;
+	dc_texturemid = texturemid;
+	dc_source = R_GetColumn(texnum,texturecolumn);
+	colfunc ();
+	return;
+    }
+
+    if (b->count
+	&& (b->colormap != dc_colormap
+	    || b->x + b->count != rw_x))
+    {
+	R_FlushWallBatch (b);
+    }
+
+    if (!b->count)
+    {
+	b->x = rw_x;
+	b->texnum = texnum;
+	b->texturemid = texturemid;
+	b->colormap = dc_colormap;
+    }
+
+    i = b->count++;
+    b->yl[i] = yl;
+    b->yh[i] = yh;
+    b->iscale[i] = dc_iscale;
+    b->texturecolumn[i] = texturecolumn;
+
+    if (b->count == QUADCOLUMNS)
+	R_FlushWallBatch (b);
+}
+
+
 void R_RenderSegLoop (void)
 {
     angle_t		angle;
@@ -277,11 +425,11 @@ void R_RenderSegLoop (void)
 	if (midtexture)
 	{
 	    // single sided line
-	    dc_yl = yl;
-	    dc_yh = yh;
-	    dc_texturemid = rw_midtexturemid;
-	    dc_source = R_GetColumn(midtexture,texturecolumn);
-	    colfunc ();
+	    if (yl <= yh)
+	    {
+		R_QueueWallColumn (&midbatch, midtexture, rw_midtexturemid,
+				   texturecolumn, yl, yh);
+	    }
 	    ceilingclip[rw_x] = viewheight;
 	    floorclip[rw_x] = -1;
 	}
@@ -299,11 +447,8 @@ void R_RenderSegLoop (void)
 
 		if (mid >= yl)
 		{
-		    dc_yl = yl;
-		    dc_yh = mid;
-		    dc_texturemid = rw_toptexturemid;
-		    dc_source = R_GetColumn(toptexture,texturecolumn);
-		    colfunc ();
+		    R_QueueWallColumn (&topbatch, toptexture, rw_toptexturemid,
+				       texturecolumn, yl, mid);
 		    ceilingclip[rw_x] = mid;
 		}
 		else
@@ -328,12 +473,9 @@ void R_RenderSegLoop (void)
 		
 		if (mid <= yh)
 		{
-		    dc_yl = mid;
-		    dc_yh = yh;
-		    dc_texturemid = rw_bottomtexturemid;
-		    dc_source = R_GetColumn(bottomtexture,
-					    texturecolumn);
-		    colfunc ();
+		    R_QueueWallColumn (&bottombatch, bottomtexture,
+				       rw_bottomtexturemid,
+				       texturecolumn, mid, yh);
 		    floorclip[rw_x] = mid;
 		}
 		else
@@ -358,6 +500,11 @@ void R_RenderSegLoop (void)
 	topfrac += topstep;
 	bottomfrac += bottomstep;
     }
+
+    // draw what is left of the runs
+    R_FlushWallBatch (&topbatch);
+    R_FlushWallBatch (&midbatch);
+    R_FlushWallBatch (&bottombatch);
 }
 
 
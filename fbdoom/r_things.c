@@ -829,6 +829,110 @@ void R_SortVisSprites (void)
 
 
 
+//
+// Drawseg column blocks.
+// The screen is split into blocks of 1<<DSBLOCKSHIFT columns,
+//  and each block lists the drawsegs that touch it, so sprites
+//  only look at the segs overlapping their own x1..x2.
+// Lists are kept from last drawseg to first, the same order
+//  the full scan in R_DrawSprite used to visit them.
+//
+#define DSBLOCKSHIFT		5
+#define DSBLOCKS		((SCREENWIDTH+(1<<DSBLOCKSHIFT)-1)>>DSBLOCKSHIFT)
+
+static short		dsblocklist[DSBLOCKS][MAXDRAWSEGS];
+static int		dsblockcount[DSBLOCKS];
+
+// merge cursors for the sprite being clipped
+static int		dscursor[DSBLOCKS];
+static int		dsblock1;
+static int		dsblock2;
+
+
+//
+// R_BuildDrawsegBlocks
+// Called once per frame, after the BSP walk has
+//  produced all the drawsegs.
+//
+static void R_BuildDrawsegBlocks (void)
+{
+    drawseg_t*		ds;
+    int			b;
+    int			b2;
+
+    for (b=0 ; b<DSBLOCKS ; b++)
+	dsblockcount[b] = 0;
+
+    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    {
+	// segs that can never clip a sprite
+	if (!ds->silhouette && !ds->maskedtexturecol)
+	    continue;
+
+	b2 = ds->x2 >> DSBLOCKSHIFT;
+
+	for (b = ds->x1 >> DSBLOCKSHIFT ; b<=b2 ; b++)
+	    dsblocklist[b][dsblockcount[b]++] = ds - drawsegs;
+    }
+}
+
+
+//
+// R_NextClipSeg
+// Returns the next drawseg overlapping the blocks set up
+//  by R_FirstClipSeg, in descending drawseg order.
+// A seg spanning several blocks is only returned once.
+//
+static drawseg_t* R_NextClipSeg (void)
+{
+    int			b;
+    int			best;
+    int			i;
+
+    best = -1;
+
+    for (b=dsblock1 ; b<=dsblock2 ; b++)
+    {
+	if (dscursor[b] < dsblockcount[b])
+	{
+	    i = dsblocklist[b][dscursor[b]];
+
+	    if (i > best)
+		best = i;
+	}
+    }
+
+    if (best < 0)
+	return NULL;
+
+    for (b=dsblock1 ; b<=dsblock2 ; b++)
+    {
+	if (dscursor[b] < dsblockcount[b]
+	    && dsblocklist[b][dscursor[b]] == best)
+	{
+	    dscursor[b]++;
+	}
+    }
+
+    return &drawsegs[best];
+}
+
+
+static drawseg_t* R_FirstClipSeg (vissprite_t* spr)
+{
+    int			b;
+
+    dsblock1 = spr->x1 >> DSBLOCKSHIFT;
+    dsblock2 = spr->x2 >> DSBLOCKSHIFT;
+
+    for (b=dsblock1 ; b<=dsblock2 ; b++)
+	dscursor[b] = 0;
+
+    return R_NextClipSeg ();
+}
+
+
+
 //
 // R_DrawSprite
 //
@@ -850,13 +954,13 @@ void R_DrawSprite (vissprite_t* spr)
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    // Only segs sharing a column block with the sprite
+    //  are visited; the rest can not overlap it.
+    for (ds=R_FirstClipSeg (spr) ; ds ; ds=R_NextClipSeg ())
     {
 	// determine if the drawseg obscures the sprite
 	if (ds->x1 > spr->x2
-	    || ds->x2 < spr->x1
-	    || (!ds->silhouette
-		&& !ds->maskedtexturecol) )
+	    || ds->x2 < spr->x1)
 	{
 	    // does not cover sprite
 	    continue;
@@ -957,6 +1061,8 @@ void R_DrawMasked (void)
 
     if (vissprite_p > vissprites)
     {
+	R_BuildDrawsegBlocks ();
+
 	// draw all vissprites back to front
 	for (spr = vsprsortedhead.next ;
 	     spr != &vsprsortedhead ;
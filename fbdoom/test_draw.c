@@ -0,0 +1,336 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Checks R_DrawColumnFast and R_DrawSpanFast against
+//	R_DrawColumn and R_DrawSpan, in the row-major and the
+//	transposed view layouts. Built and run by "make test".
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+
+#include "r_local.h"
+
+
+// Bytes before and after the view that no drawer may touch.
+#define GUARD		4096
+
+#define VIEWSIZE	(SCREENWIDTH*SCREENHEIGHT)
+#define BUFSIZE		(GUARD + VIEWSIZE + GUARD)
+
+// r_draw.c
+extern byte*	ylookup[];
+extern int	columnofs[];
+
+static byte	buffer[BUFSIZE];
+static byte	poison[2][BUFSIZE];
+static byte	refout[BUFSIZE];
+
+static byte	colormap[256];
+static byte	column[128];
+static byte	flat[64*64];
+
+static unsigned int	seed = 1;
+static int		failures;
+static int		tests;
+
+static unsigned int Random (void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    return seed;
+}
+
+static int RandomRange (int lo, int hi)
+{
+    return lo + (int) (Random () % (unsigned int) (hi - lo + 1));
+}
+
+
+//
+// SetLayout
+// The same view setup R_InitBuffer makes for a full screen view.
+//
+static void SetLayout (boolean transposed)
+{
+    byte*	view;
+    int		i;
+
+    view = buffer + GUARD;
+
+    if (!transposed)
+    {
+	for (i=0 ; i<SCREENWIDTH ; i++)
+	    columnofs[i] = i;
+	for (i=0 ; i<SCREENHEIGHT ; i++)
+	    ylookup[i] = view + i*SCREENWIDTH;
+
+	dc_pitch = SCREENWIDTH;
+	ds_pitch = 1;
+    }
+    else
+    {
+	for (i=0 ; i<SCREENWIDTH ; i++)
+	    columnofs[i] = i*SCREENHEIGHT;
+	for (i=0 ; i<SCREENHEIGHT ; i++)
+	    ylookup[i] = view + i;
+
+	dc_pitch = 1;
+	ds_pitch = SCREENHEIGHT;
+    }
+}
+
+
+//
+// Compare
+// Runs both drawers over each of the two poison patterns.
+// The patterns differ in every byte, so matching output over
+//  both means the same bytes were written with the same values
+//  and no other byte was touched.
+//
+static void Compare (void (*ref) (void), void (*fast) (void),
+		     const char *name, const char *layout)
+{
+    int		i;
+    int		j;
+
+    tests++;
+
+    for (i=0 ; i<2 ; i++)
+    {
+	memcpy (buffer, poison[i], BUFSIZE);
+	ref ();
+	memcpy (refout, buffer, BUFSIZE);
+
+	memcpy (buffer, poison[i], BUFSIZE);
+	fast ();
+
+	if (memcmp (buffer, refout, BUFSIZE) == 0)
+	    continue;
+
+	for (j=0 ; buffer[j] == refout[j] ; j++)
+	    ;
+
+	failures++;
+
+	if (failures <= 10)
+	{
+	    printf ("%s (%s): byte %i is %i, should be %i\n",
+		    name, layout, j - GUARD, buffer[j], refout[j]);
+
+	    if (ref == R_DrawColumn)
+	    {
+		printf ("    dc_x %i dc_yl %i dc_yh %i centery %i "
+			"dc_iscale 0x%x dc_texturemid 0x%x\n",
+			dc_x, dc_yl, dc_yh, centery,
+			dc_iscale, dc_texturemid);
+	    }
+	    else
+	    {
+		printf ("    ds_y %i ds_x1 %i ds_x2 %i "
+			"ds_xfrac 0x%x ds_yfrac 0x%x "
+			"ds_xstep 0x%x ds_ystep 0x%x\n",
+			ds_y, ds_x1, ds_x2,
+			ds_xfrac, ds_yfrac, ds_xstep, ds_ystep);
+	    }
+	}
+
+	return;
+    }
+}
+
+
+static void CompareColumn (const char *layout)
+{
+    Compare (R_DrawColumn, R_DrawColumnFast, "R_DrawColumnFast", layout);
+}
+
+static void CompareSpan (const char *layout)
+{
+    Compare (R_DrawSpan, R_DrawSpanFast, "R_DrawSpanFast", layout);
+}
+
+
+//
+// TestColumns
+//
+static void TestColumns (const char *layout)
+{
+    int		i;
+    int		count;
+
+    dc_colormap = colormap;
+    dc_source = column;
+    centery = SCREENHEIGHT/2;
+
+    // Random columns, most of which wrap the texture.
+    for (i=0 ; i<20000 ; i++)
+    {
+	dc_x = RandomRange (0, SCREENWIDTH-1);
+	dc_yl = RandomRange (0, SCREENHEIGHT-1);
+	dc_yh = RandomRange (dc_yl - 1, SCREENHEIGHT-1);
+	centery = RandomRange (0, SCREENHEIGHT);
+	dc_iscale = Random () >> RandomRange (0, 31);
+	dc_texturemid = Random ();
+
+	CompareColumn (layout);
+    }
+
+    // Columns that stay inside the texture, the unmasked path,
+    //  at every length and every remainder of the unrolled loop.
+    for (count=0 ; count<SCREENHEIGHT ; count++)
+    {
+	dc_x = RandomRange (0, SCREENWIDTH-1);
+	dc_yl = RandomRange (0, SCREENHEIGHT-1-count);
+	dc_yh = dc_yl + count;
+	centery = dc_yl;
+	dc_iscale = (127<<FRACBITS) / (count+1);
+	dc_texturemid = RandomRange (0, FRACUNIT-1);
+
+	CompareColumn (layout);
+    }
+
+    // Last pixel just inside and just past the end of the texture.
+    for (count=1 ; count<SCREENHEIGHT ; count++)
+    {
+	dc_x = RandomRange (0, SCREENWIDTH-1);
+	dc_yl = 0;
+	dc_yh = count;
+	centery = 0;
+	dc_iscale = RandomRange (1, (128<<FRACBITS) / count);
+
+	dc_texturemid = (128<<FRACBITS) - 1 - count*dc_iscale;
+	CompareColumn (layout);
+
+	dc_texturemid = (128<<FRACBITS) - count*dc_iscale;
+	CompareColumn (layout);
+
+	dc_texturemid = -1;
+	CompareColumn (layout);
+    }
+
+    // The step takes frac past 0x7fffffff: in 32 bits the last
+    //  texel would look like it is back inside the texture.
+    for (i=0 ; i<2000 ; i++)
+    {
+	dc_x = RandomRange (0, SCREENWIDTH-1);
+	dc_yl = 0;
+	dc_yh = RandomRange (1, SCREENHEIGHT-1);
+	centery = 0;
+	dc_texturemid = RandomRange (0, 127<<FRACBITS);
+	dc_iscale = (int) (0x80000000u / (unsigned int) dc_yh)
+		  + RandomRange (0, 0x10000);
+
+	CompareColumn (layout);
+    }
+}
+
+
+//
+// TestSpans
+//
+static void TestSpans (const char *layout)
+{
+    int		i;
+    int		count;
+
+    ds_colormap = colormap;
+    ds_source = flat;
+
+    // Random spans with any position and step,
+    //  which wrap the flat in both directions.
+    for (i=0 ; i<20000 ; i++)
+    {
+	ds_y = RandomRange (0, SCREENHEIGHT-1);
+	ds_x1 = RandomRange (0, SCREENWIDTH-1);
+	ds_x2 = RandomRange (ds_x1, SCREENWIDTH-1);
+	ds_xfrac = Random ();
+	ds_yfrac = Random ();
+	ds_xstep = Random () >> RandomRange (0, 31);
+	ds_ystep = Random () >> RandomRange (0, 31);
+
+	if (Random () & 1)
+	    ds_xstep = -ds_xstep;
+	if (Random () & 1)
+	    ds_ystep = -ds_ystep;
+
+	CompareSpan (layout);
+    }
+
+    // Every length, for every remainder of the eight pixel blocks.
+    for (count=1 ; count<=SCREENWIDTH ; count++)
+    {
+	ds_y = RandomRange (0, SCREENHEIGHT-1);
+	ds_x1 = RandomRange (0, SCREENWIDTH-count);
+	ds_x2 = ds_x1 + count - 1;
+	ds_xfrac = Random ();
+	ds_yfrac = Random ();
+	ds_xstep = (int) Random () >> 8;
+	ds_ystep = (int) Random () >> 8;
+
+	CompareSpan (layout);
+    }
+
+    // Packed position overflowing out of the y half into x,
+    //  and out of the top of the x half.
+    for (i=0 ; i<2000 ; i++)
+    {
+	ds_y = RandomRange (0, SCREENHEIGHT-1);
+	ds_x1 = RandomRange (0, SCREENWIDTH-17);
+	ds_x2 = ds_x1 + RandomRange (0, 16);
+	ds_xfrac = (63<<FRACBITS) + RandomRange (0, FRACUNIT-1);
+	ds_yfrac = (63<<FRACBITS) + RandomRange (0, FRACUNIT-1);
+	ds_xstep = RandomRange (FRACUNIT/2, 4*FRACUNIT);
+	ds_ystep = RandomRange (FRACUNIT/2, 4*FRACUNIT);
+
+	CompareSpan (layout);
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+    int		i;
+
+    for (i=0 ; i<BUFSIZE ; i++)
+    {
+	poison[0][i] = Random ();
+	poison[1][i] = ~poison[0][i];
+    }
+
+    for (i=0 ; i<256 ; i++)
+	colormap[i] = Random ();
+    for (i=0 ; i<128 ; i++)
+	column[i] = Random ();
+    for (i=0 ; i<64*64 ; i++)
+	flat[i] = Random ();
+
+    SetLayout (false);
+    TestColumns ("row-major");
+    TestSpans ("row-major");
+
+    SetLayout (true);
+    TestColumns ("transposed");
+    TestSpans ("transposed");
+
+    printf ("%i of %i drawer tests failed\n", failures, tests);
+
+    return failures != 0;
+}
@@ -0,0 +1,276 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Checks that a level cache file is not used once the map
+//	it was built from has been edited in place, keeping the
+//	sizes of its lumps.  Built and run by "make test".
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/wait.h>
+
+#include "doomdef.h"
+
+#include "m_argv.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "p_local.h"
+
+
+#define LUMPSIZE	64
+
+// The map marker and the lumps after it.
+#define NUMLUMPS	(ML_BLOCKMAP+1)
+
+// Any fixed time, put back after an edit that should not
+//  need it to be noticed.
+#define STAMP		1000000000
+
+static const char *lumpnames[NUMLUMPS] =
+{
+    "MAP01", "THINGS", "LINEDEFS", "SIDEDEFS", "VERTEXES", "SEGS",
+    "SSECTORS", "NODES", "SECTORS", "REJECT", "BLOCKMAP"
+};
+
+static byte	lumps[NUMLUMPS][LUMPSIZE];	// but the marker
+
+static char	dir[] = "/tmp/levelcacheXXXXXX";
+static char	*wadname;
+static char	*cachedir;
+
+static int	failures;
+static int	tests;
+
+static byte	reject[LUMPSIZE];
+static int32_t	blockmapdata[1];
+
+enum
+{
+    MISS,
+    HIT
+};
+
+
+static void WriteInt32 (FILE *f, int value)
+{
+    byte	b[4];
+
+    b[0] = value;
+    b[1] = value >> 8;
+    b[2] = value >> 16;
+    b[3] = value >> 24;
+
+    fwrite (b, 1, 4, f);
+}
+
+//
+// WriteWad
+// Writes the map out with the given modification time.
+//
+static void WriteWad (time_t stamp)
+{
+    struct utimbuf	times;
+    FILE		*f;
+    char		name[8];
+    int			i;
+
+    f = fopen (wadname, "wb");
+
+    if (f == NULL)
+    {
+	perror (wadname);
+	exit (1);
+    }
+
+    fwrite ("PWAD", 1, 4, f);
+    WriteInt32 (f, NUMLUMPS);
+    WriteInt32 (f, 12 + ML_BLOCKMAP * LUMPSIZE);
+    fwrite (lumps[ML_THINGS], LUMPSIZE, ML_BLOCKMAP, f);
+
+    for (i=0 ; i<NUMLUMPS ; i++)
+    {
+	WriteInt32 (f, i == ML_LABEL ? 12 : 12 + (i-1) * LUMPSIZE);
+	WriteInt32 (f, i == ML_LABEL ? 0 : LUMPSIZE);
+	memset (name, 0, sizeof(name));
+	memcpy (name, lumpnames[i], strlen (lumpnames[i]));
+	fwrite (name, 1, 8, f);
+    }
+
+    fclose (f);
+
+    times.actime = stamp;
+    times.modtime = stamp;
+    utime (wadname, &times);
+}
+
+//
+// LoadMap
+// Looks the map up in a new process, as a fresh start of the
+//  game would, and saves a cache for it if there was none.
+//
+static int LoadMap (void)
+{
+    static char	*argv[] = { "test_levelcache", NULL };
+    pid_t	pid;
+    int		status;
+    int		lumpnum;
+
+    fflush (stdout);
+    pid = fork ();
+
+    if (pid == 0)
+    {
+	myargc = 1;
+	myargv = argv;
+
+	Z_Init ();
+	configdir = M_StringJoin (dir, DIR_SEPARATOR_S, NULL);
+
+	if (W_AddFile (wadname) == NULL)
+	    _exit (2);
+
+	P_InitLevelCache ();
+	lumpnum = W_GetNumForName ("MAP01");
+
+	if (P_ReadLevelCache (lumpnum) != NULL)
+	    _exit (HIT);
+
+	// Enough of a level for P_WriteLevelCache.
+	rejectmatrix = reject;
+	blockmaplump = blockmapdata;
+
+	P_WriteLevelCache (lumpnum);
+	_exit (MISS);
+    }
+
+    if (pid < 0 || waitpid (pid, &status, 0) != pid
+     || !WIFEXITED (status) || WEXITSTATUS (status) > HIT)
+    {
+	printf ("loading the map failed\n");
+	exit (1);
+    }
+
+    return WEXITSTATUS (status);
+}
+
+static void Check (const char *what, int expected)
+{
+    tests++;
+
+    if (LoadMap () != expected)
+    {
+	failures++;
+	printf ("%s: cache %s, should %s\n", what,
+		expected == HIT ? "missed" : "used",
+		expected == HIT ? "be used" : "miss");
+    }
+}
+
+//
+// RemoveAll
+//
+static void RemoveAll (void)
+{
+    struct dirent	*entry;
+    DIR			*d;
+    char		*path;
+
+    d = opendir (cachedir);
+
+    if (d != NULL)
+    {
+	while ((entry = readdir (d)) != NULL)
+	{
+	    if (entry->d_name[0] == '.')
+		continue;
+
+	    path = M_StringJoin (cachedir, DIR_SEPARATOR_S,
+				 entry->d_name, NULL);
+	    remove (path);
+	    free (path);
+	}
+
+	closedir (d);
+    }
+
+    rmdir (cachedir);
+    remove (wadname);
+    rmdir (dir);
+}
+
+
+int main (int argc, char **argv)
+{
+    char	what[32];
+    int		i;
+    int		j;
+
+    if (mkdtemp (dir) == NULL)
+    {
+	perror (dir);
+	return 1;
+    }
+
+    wadname = M_StringJoin (dir, DIR_SEPARATOR_S, "test.wad", NULL);
+    cachedir = M_StringJoin (dir, DIR_SEPARATOR_S, "levelcache", NULL);
+
+    for (i=0 ; i<NUMLUMPS ; i++)
+	for (j=0 ; j<LUMPSIZE ; j++)
+	    lumps[i][j] = i * LUMPSIZE + j;
+
+    WriteWad (STAMP);
+    Check ("first load", MISS);
+    Check ("second load", HIT);
+
+    // Every lump the cache is built from, bar the reject and
+    //  blockmap, is checked by its contents alone.
+    for (i=ML_LINEDEFS ; i<=ML_SECTORS ; i++)
+    {
+	lumps[i][LUMPSIZE/2] ^= 1;
+	WriteWad (STAMP);
+
+	M_snprintf (what, sizeof(what), "%s edited", lumpnames[i]);
+	Check (what, MISS);
+	M_snprintf (what, sizeof(what), "%s reloaded", lumpnames[i]);
+	Check (what, HIT);
+    }
+
+    // The reject and blockmap by the time of the file.
+    for (i=ML_REJECT ; i<=ML_BLOCKMAP ; i++)
+    {
+	lumps[i][LUMPSIZE/2] ^= 1;
+	WriteWad (STAMP + i);
+
+	M_snprintf (what, sizeof(what), "%s edited", lumpnames[i]);
+	Check (what, MISS);
+	M_snprintf (what, sizeof(what), "%s reloaded", lumpnames[i]);
+	Check (what, HIT);
+    }
+
+    RemoveAll ();
+
+    printf ("%i of %i level cache tests failed\n", failures, tests);
+
+    return failures != 0;
+}
@@ -85,3 +85,34 @@ void W_Checksum(sha1_digest_t digest)
     SHA1_Final(digest, &sha1_context);
 }
 
+static void ChecksumAddFile(sha1_context_t *sha1_context, wad_file_t *wad)
+{
+    SHA1_UpdateInt32(sha1_context, wad->length);
+    SHA1_UpdateInt32(sha1_context, (unsigned int) wad->mtime);
+}
+
+void W_ChecksumLumpFile(sha1_context_t *sha1_context, int lumpnum)
+{
+    ChecksumAddFile(sha1_context, lumpinfo[lumpnum].wad_file);
+}
+
+void W_ChecksumFiles(sha1_context_t *sha1_context)
+{
+    wad_file_t *last;
+    unsigned int i;
+
+    last = NULL;
+
+    // The lumps of each file are next to each other in the
+    // directory.
+
+    for (i=0; i<numlumps; ++i)
+    {
+        if (lumpinfo[i].wad_file != last)
+        {
+            last = lumpinfo[i].wad_file;
+            ChecksumAddFile(sha1_context, last);
+        }
+    }
+}
+
@@ -20,8 +20,15 @@
 #define W_CHECKSUM_H
 
 #include "doomtype.h"
+#include "sha1.h"
 
 extern void W_Checksum(sha1_digest_t digest);
 
+// Add the size and modification time of the WAD file holding
+// a lump, or of every WAD file in use, to a checksum.
+
+extern void W_ChecksumLumpFile(sha1_context_t *context, int lumpnum);
+extern void W_ChecksumFiles(sha1_context_t *context);
+
 #endif /* #ifndef W_CHECKSUM_H */
 
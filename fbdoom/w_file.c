@@ -17,6 +17,7 @@
 //
 
 #include <stdio.h>
+#include <sys/stat.h>
 
 #include "config.h"
 
@@ -46,7 +47,7 @@ static wad_file_class_t *wad_file_classes[] =
     &stdc_wad_file,
 };
 
-wad_file_t *W_OpenFile(char *path)
+static wad_file_t *OpenFile(char *path)
 {
     wad_file_t *result;
     int i;
@@ -78,6 +79,31 @@ wad_file_t *W_OpenFile(char *path)
     return result;
 }
 
+wad_file_t *W_OpenFile(char *path)
+{
+    wad_file_t *result;
+    struct stat st;
+
+    result = OpenFile(path);
+
+    if (result != NULL)
+    {
+        // Saved caches of data built from the file check this
+        // to notice that it has been changed.
+
+        if (stat(path, &st) == 0)
+        {
+            result->mtime = st.st_mtime;
+        }
+        else
+        {
+            result->mtime = 0;
+        }
+    }
+
+    return result;
+}
+
 void W_CloseFile(wad_file_t *wad)
 {
     wad->file_class->CloseFile(wad);
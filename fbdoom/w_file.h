@@ -21,6 +21,7 @@
 #define __W_FILE__
 
 #include <stdio.h>
+#include <time.h>
 #include "doomtype.h"
 
 typedef struct _wad_file_s wad_file_t;
@@ -57,6 +58,10 @@ struct _wad_file_s
     // Length of the file, in bytes.
 
     unsigned int length;
+
+    // Time the file was last modified, or 0 if unknown.
+
+    time_t mtime;
 };
 
 // Open the specified file. Returns a pointer to a new wad_file_t 
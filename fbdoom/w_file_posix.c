@@ -0,0 +1,146 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions, memory mapped with the POSIX mmap() call.
+//
+
+#include "config.h"
+
+#ifdef HAVE_MMAP
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "w_file.h"
+#include "z_zone.h"
+
+typedef struct
+{
+    wad_file_t wad;
+    int handle;
+} posix_wad_file_t;
+
+extern wad_file_class_t posix_wad_file;
+
+static void *MapFile(int handle, unsigned int length)
+{
+    void *result;
+
+    // Map private and writable, as Chocolate Doom does.  Pages
+    // are shared with the page cache until written to; code that
+    // byte swaps or patches a cached lump in place gets a private
+    // copy of the page, and the WAD file is never changed.
+
+    result = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                  handle, 0);
+
+    if (result == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // Lumps are picked out all over the file as levels load; have
+    // the kernel start reading it in now rather than fault by fault.
+
+    madvise(result, length, MADV_WILLNEED);
+
+    return result;
+}
+
+static wad_file_t *W_POSIX_OpenFile(char *path)
+{
+    posix_wad_file_t *result;
+    struct stat st;
+    int handle;
+    void *mapped;
+
+    handle = open(path, O_RDONLY);
+
+    if (handle < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(handle, &st) < 0 || st.st_size <= 0)
+    {
+        close(handle);
+        return NULL;
+    }
+
+    mapped = MapFile(handle, st.st_size);
+
+    if (mapped == NULL)
+    {
+        close(handle);
+        return NULL;
+    }
+
+    // Create a new posix_wad_file_t to hold the file handle.
+
+    result = Z_Malloc(sizeof(posix_wad_file_t), PU_STATIC, 0);
+    result->wad.file_class = &posix_wad_file;
+    result->wad.mapped = mapped;
+    result->wad.length = st.st_size;
+    result->handle = handle;
+
+    return &result->wad;
+}
+
+static void W_POSIX_CloseFile(wad_file_t *wad)
+{
+    posix_wad_file_t *posix_wad;
+
+    posix_wad = (posix_wad_file_t *) wad;
+
+    munmap(posix_wad->wad.mapped, posix_wad->wad.length);
+    close(posix_wad->handle);
+    Z_Free(posix_wad);
+}
+
+// Read data from the specified position in the file into the
+// provided buffer.  Returns the number of bytes read.
+
+size_t W_POSIX_Read(wad_file_t *wad, unsigned int offset,
+                    void *buffer, size_t buffer_len)
+{
+    if (offset >= wad->length)
+    {
+        return 0;
+    }
+
+    if (buffer_len > wad->length - offset)
+    {
+        buffer_len = wad->length - offset;
+    }
+
+    memcpy(buffer, wad->mapped + offset, buffer_len);
+
+    return buffer_len;
+}
+
+
+wad_file_class_t posix_wad_file =
+{
+    W_POSIX_OpenFile,
+    W_POSIX_CloseFile,
+    W_POSIX_Read,
+};
+
+#endif /* #ifdef HAVE_MMAP */
+
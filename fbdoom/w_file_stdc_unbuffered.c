@@ -98,15 +98,13 @@ size_t W_StdC_Read(wad_file_t *wad, unsigned int offset,
 
     stdc_wad = (stdc_wad_file_t *) wad;
 
-    // Jump to the specified position in the file.
-
-    lseek(stdc_wad->fd, offset, SEEK_SET);
-
-    // Read into the buffer.
+    // Read into the buffer.  pread() leaves the file position
+    // alone, so the level prefetch thread can read at the same time.
 
     do {
 
-        rc = read(stdc_wad->fd, (char *)buffer + result, buffer_len - result);
+        rc = pread(stdc_wad->fd, (char *)buffer + result,
+                   buffer_len - result, offset + result);
 
         if (rc <= 0) {
 
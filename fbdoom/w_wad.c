@@ -61,9 +61,13 @@ typedef struct
 lumpinfo_t *lumpinfo;		
 unsigned int numlumps = 0;
 
-// Hash table for fast lookups
+// Open addressed hash table for fast lookups: lump numbers,
+// -1 for an empty slot.  lumpkeys[] holds the packed name of
+// every lump (see W_LumpNameKey).
 
-static lumpinfo_t **lumphash;
+static int *lumphash;
+static unsigned int lumphashmask;
+static uint64_t *lumpkeys;
 
 // Hash function used for lump names.
 
@@ -83,6 +87,33 @@ unsigned int W_LumpNameHash(const char *s)
     return result;
 }
 
+//
+// W_LumpNameKey
+// Packs a lump name, upper cased and zero padded, into one
+// 64 bit key: two names are equal (as strncasecmp(a, b, 8)
+// sees them) exactly when their keys are.
+//
+uint64_t W_LumpNameKey(const char *name)
+{
+    uint64_t key = 0;
+    unsigned int i;
+
+    for (i=0; i < 8 && name[i] != '\0'; ++i)
+    {
+        key |= (uint64_t) (byte) toupper((int)name[i]) << (i * 8);
+    }
+
+    return key;
+}
+
+// Hash of a packed name, to be masked down to a power of two
+// table size.
+
+unsigned int W_LumpKeyHash(uint64_t key)
+{
+    return (unsigned int) ((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
 // Increase the size of the lumpinfo[] array to the specified size.
 static void ExtendLumpInfo(int newnumlumps)
 {
@@ -107,14 +138,6 @@ static void ExtendLumpInfo(int newnumlumps)
         {
             Z_ChangeUser(newlumpinfo[i].cache, &newlumpinfo[i].cache);
         }
-
-        // We shouldn't be generating a hash table until after all WADs have
-        // been loaded, but just in case...
-        if (lumpinfo[i].next != NULL)
-        {
-            int nextlumpnum = lumpinfo[i].next - lumpinfo;
-            newlumpinfo[i].next = &newlumpinfo[nextlumpnum];
-        }
     }
 
     // All done.
@@ -230,7 +253,9 @@ wad_file_t *W_AddFile (char *filename)
     if (lumphash != NULL)
     {
         Z_Free(lumphash);
+        Z_Free(lumpkeys);
         lumphash = NULL;
+        lumpkeys = NULL;
     }
 
     return wad_file;
@@ -255,25 +280,28 @@ int W_NumLumps (void)
 
 int W_CheckNumForName (char* name)
 {
-    lumpinfo_t *lump_p;
+    uint64_t key;
+    unsigned int slot;
     int i;
 
+    key = W_LumpNameKey(name);
+
     // Do we have a hash table yet?
 
     if (lumphash != NULL)
     {
-        int hash;
-        
         // We do! Excellent.
 
-        hash = W_LumpNameHash(name) % numlumps;
-        
-        for (lump_p = lumphash[hash]; lump_p != NULL; lump_p = lump_p->next)
+        slot = W_LumpKeyHash(key) & lumphashmask;
+
+        for (i = lumphash[slot]; i >= 0; i = lumphash[slot])
         {
-            if (!strncasecmp(lump_p->name, name, 8))
+            if (lumpkeys[i] == key)
             {
-                return lump_p - lumpinfo;
+                return i;
             }
+
+            slot = (slot + 1) & lumphashmask;
         }
     } 
     else
@@ -284,7 +312,7 @@ int W_CheckNumForName (char* name)
 
         for (i=numlumps-1; i >= 0; --i)
         {
-            if (!strncasecmp(lumpinfo[i].name, name, 8))
+            if (W_LumpNameKey(lumpinfo[i].name) == key)
             {
                 return i;
             }
@@ -334,6 +362,123 @@ int W_LumpLength (unsigned int lump)
 
 
 
+//
+// LUMP STAGING
+// Lumps read ahead by the level prefetch thread (see
+//  P_PrefetchLevel), kept in plain malloc memory as the
+//  zone is not thread safe.
+// Between W_BeginStaging and W_EndStaging only the thread
+//  touches the staged lumps; W_ReadLump ignores them.
+//
+
+static byte **staged_lumps = NULL;
+static int staged_bytes;
+static int staging_budget;
+static boolean staging_busy = false;
+
+void W_BeginStaging(int budget)
+{
+    W_DropStagedLumps();
+
+    if (staged_lumps == NULL)
+    {
+        staged_lumps = calloc(numlumps, sizeof(*staged_lumps));
+    }
+
+    staging_budget = budget;
+    staging_busy = true;
+}
+
+void W_EndStaging(void)
+{
+    staging_busy = false;
+}
+
+//
+// W_StageLump
+// Called from the prefetch thread.  Returns the staged copy
+// of the lump, or NULL if it is mapped or does not fit.
+//
+byte *W_StageLump(int lumpnum)
+{
+    lumpinfo_t *l;
+    byte *data;
+
+    if ((unsigned)lumpnum >= numlumps || staged_lumps == NULL)
+    {
+        return NULL;
+    }
+
+    if (staged_lumps[lumpnum] != NULL)
+    {
+        return staged_lumps[lumpnum];
+    }
+
+    l = lumpinfo+lumpnum;
+
+    if (l->wad_file->mapped != NULL
+     || staged_bytes + l->size > staging_budget)
+    {
+        return NULL;
+    }
+
+    data = malloc(l->size > 0 ? l->size : 1);
+
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    if (W_Read(l->wad_file, l->position, data, l->size) < l->size)
+    {
+        free(data);
+        return NULL;
+    }
+
+    staged_lumps[lumpnum] = data;
+    staged_bytes += l->size;
+
+    return data;
+}
+
+void W_DropStagedLumps(void)
+{
+    unsigned int i;
+
+    if (staged_lumps == NULL || staging_busy)
+    {
+        return;
+    }
+
+    for (i=0; i<numlumps; ++i)
+    {
+        free(staged_lumps[i]);
+        staged_lumps[i] = NULL;
+    }
+
+    staged_bytes = 0;
+}
+
+// Moves a staged lump into dest, if there is one.
+
+static boolean W_TakeStagedLump(unsigned int lump, void *dest)
+{
+    if (staged_lumps == NULL || staging_busy
+     || staged_lumps[lump] == NULL)
+    {
+        return false;
+    }
+
+    memcpy(dest, staged_lumps[lump], lumpinfo[lump].size);
+
+    free(staged_lumps[lump]);
+    staged_lumps[lump] = NULL;
+    staged_bytes -= lumpinfo[lump].size;
+
+    return true;
+}
+
+
 //
 // W_ReadLump
 // Loads the lump into the given buffer,
@@ -349,6 +494,11 @@ void W_ReadLump(unsigned int lump, void *dest)
 	I_Error ("W_ReadLump: %i >= numlumps", lump);
     }
 
+    if (W_TakeStagedLump(lump, dest))
+    {
+        return;
+    }
+
     l = lumpinfo+lump;
 	
     I_BeginRead ();
@@ -399,6 +549,8 @@ void *W_CacheLumpNum(int lumpnum, int tag)
     if (lump->wad_file->mapped != NULL)
     {
         // Memory mapped file, return from the mmapped region.
+        // The mapping is private, so a lump changed in place is
+        // only changed in this process, as a zone copy would be.
 
         result = lump->wad_file->mapped + lump->position;
     }
@@ -431,6 +583,22 @@ void *W_CacheLumpName(char *name, int tag)
     return W_CacheLumpNum(W_GetNumForName(name), tag);
 }
 
+//
+// W_CacheLumpNameCached
+// For names looked up every frame: the lump number is kept in
+// *lumpnum at the call site, which starts out as -1.  Only use
+// once all WADs have been added and DEH_String replacements made.
+//
+void *W_CacheLumpNameCached(char *name, int *lumpnum, int tag)
+{
+    if (*lumpnum < 0)
+    {
+        *lumpnum = W_GetNumForName(name);
+    }
+
+    return W_CacheLumpNum(*lumpnum, tag);
+}
+
 // 
 // Release a lump back to the cache, so that it can be reused later 
 // without having to read from disk again, or alternatively, discarded
@@ -539,30 +707,48 @@ void W_Profile (void)
 void W_GenerateHashTable(void)
 {
     unsigned int i;
+    unsigned int size;
+    unsigned int slot;
 
     // Free the old hash table, if there is one
 
     if (lumphash != NULL)
     {
         Z_Free(lumphash);
+        Z_Free(lumpkeys);
+        lumphash = NULL;
+        lumpkeys = NULL;
     }
 
     // Generate hash table
     if (numlumps > 0)
     {
-        lumphash = Z_Malloc(sizeof(lumpinfo_t *) * numlumps, PU_STATIC, NULL);
-        memset(lumphash, 0, sizeof(lumpinfo_t *) * numlumps);
+        // Keep the table at most half full.
+
+        for (size = 1; size < numlumps * 2; size <<= 1);
+
+        lumphash = Z_Malloc(sizeof(*lumphash) * size, PU_STATIC, NULL);
+        memset(lumphash, -1, sizeof(*lumphash) * size);
+        lumphashmask = size - 1;
+
+        lumpkeys = Z_Malloc(sizeof(*lumpkeys) * numlumps, PU_STATIC, NULL);
 
         for (i=0; i<numlumps; ++i)
         {
-            unsigned int hash;
+            lumpkeys[i] = W_LumpNameKey(lumpinfo[i].name);
 
-            hash = W_LumpNameHash(lumpinfo[i].name) % numlumps;
+            // Later lumps take precedence, so a lump replaces any
+            // earlier one of the same name in its slot.
 
-            // Hook into the hash table
+            slot = W_LumpKeyHash(lumpkeys[i]) & lumphashmask;
+
+            while (lumphash[slot] >= 0
+                && lumpkeys[lumphash[slot]] != lumpkeys[i])
+            {
+                slot = (slot + 1) & lumphashmask;
+            }
 
-            lumpinfo[i].next = lumphash[hash];
-            lumphash[hash] = &lumpinfo[i];
+            lumphash[slot] = i;
         }
     }
 
@@ -45,10 +45,6 @@ struct lumpinfo_s
     int		position;
     int		size;
     void       *cache;
-
-    // Used for hash table lookups
-
-    lumpinfo_t *next;
 };
 
 
@@ -65,14 +61,23 @@ void    W_ReadLump (unsigned int lump, void *dest);
 
 void*	W_CacheLumpNum (int lump, int tag);
 void*	W_CacheLumpName (char* name, int tag);
+void*	W_CacheLumpNameCached (char* name, int *lumpnum, int tag);
 
 void    W_GenerateHashTable(void);
 
 extern unsigned int W_LumpNameHash(const char *s);
+extern uint64_t W_LumpNameKey(const char *name);
+extern unsigned int W_LumpKeyHash(uint64_t key);
 
 void    W_ReleaseLumpNum(int lump);
 void    W_ReleaseLumpName(char *name);
 
 void W_CheckCorrectIWAD(GameMission_t mission);
 
+// Lumps read ahead by a background thread, see W_BeginStaging.
+void    W_BeginStaging(int budget);
+void    W_EndStaging(void);
+byte   *W_StageLump(int lumpnum);
+void    W_DropStagedLumps(void);
+
 #endif
@@ -17,9 +17,13 @@
 //
 
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomtype.h"
+#include "d_loop.h"
 
 
 //
@@ -31,11 +35,33 @@
 //
 // It is of no value to free a cachable block,
 //  because it will get overwritten automatically if needed.
+//
+// When the zone runs out of room it grows by another region,
+//  which starts with a static fence block so that nothing is
+//  merged across the gap between regions.
+//
+// Free blocks are also kept on segregated free lists, one per
+//  size class, so that Z_Malloc normally takes a block off a
+//  list without walking the zone.  Only when no free block is
+//  big enough does it purge cachable blocks to make room,
+//  the least recently used ones first.  Free space left in
+//  pieces between cachable blocks is joined up by Z_Compact,
+//  between frames.
+//
+// Like the rover, the lists hand out freed memory as late as
+//  they can: a freed block goes to the back of its list, while
+//  what is left over after an allocation goes to the front, so
+//  the next allocation carries on from there.  Vanilla code
+//  reads freed blocks through stale pointers, and a block that
+//  was just freed still holds what it held.
 // 
  
 #define MEM_ALIGN sizeof(void *)
 #define ZONEID	0x1d4a11
 
+// id of the block at the start of each region added to the zone
+#define REGIONID	0x1d4a12
+
 typedef struct memblock_s
 {
     int			size;	// including the header and possibly tiny fragments
@@ -44,9 +70,28 @@ typedef struct memblock_s
     int			id;	// should be ZONEID
     struct memblock_s*	next;
     struct memblock_s*	prev;
+    int			lastuse;	// gametic of the last use, for purging
+    int			site;		// Z_Malloc call site, see Z_SiteIndex
+
+    // free list links, only meaningful while tag is PU_FREE
+    struct memblock_s*	freenext;
+    struct memblock_s*	freeprev;
 } memblock_t;
 
 
+// Size classes: each power of two is split into FREECLASSSTEPS
+//  classes, so a class never holds blocks more than 1/8 apart.
+#define FREECLASSBITS	3
+#define FREECLASSSTEPS	(1 << FREECLASSBITS)
+#define NUMFREECLASSES	(32 << FREECLASSBITS)
+
+static memblock_t*	freelists[NUMFREECLASSES];
+static memblock_t*	freetails[NUMFREECLASSES];
+
+// a bit set for every non-empty free list
+static unsigned int	freemap[NUMFREECLASSES / 32];
+
+
 typedef struct
 {
     // total bytes malloced, including header
@@ -63,6 +108,267 @@ typedef struct
 
 memzone_t*	mainzone;
 
+// number of owned blocks released so far, see Z_PurgeCount
+static unsigned int	zonepurges;
+
+// regions added to the zone after the first, see Z_AddRegion
+#define MAXREGIONS	64
+
+typedef struct
+{
+    memblock_t*	fence;
+    int		size;
+} zoneregion_t;
+
+static zoneregion_t	regions[MAXREGIONS];
+static int		numregions;
+
+// Set when Z_MakeRoom had to purge though there was free space
+//  enough in pieces, see Z_Compact.
+static boolean		compactwanted;
+
+// Blocks Z_MakeRoom walks before settling for the best run of
+//  purgable blocks it has found.
+#define MAXSCAN		4096
+
+
+//
+// TELEMETRY
+// Kept all the time, see Z_GetStats and Z_DumpStats.
+//
+
+static zonestats_t	stats;
+
+// allocations, frees and purges so far during stattic
+static int		stattic;
+static unsigned int	ticallocs;
+static unsigned int	ticfrees;
+static unsigned int	ticpurges;
+
+// Z_Malloc call sites, hashed on file and line; the last slot
+//  takes the calls once the table is full
+#define MAXSITES	256
+
+typedef struct
+{
+    char*		file;
+    int			line;
+    int			live;
+    int			peak;
+    unsigned int	allocs;
+} zonesite_t;
+
+static zonesite_t	sites[MAXSITES + 1];
+static int		numsites;
+
+static char*	tagnames[PU_NUM_TAGS] =
+{
+    "none", "static", "sound", "music", "free",
+    "level", "levspec", "purgelevel", "cache"
+};
+
+
+static int Z_SiteIndex (char* file, int line)
+{
+    int		i;
+
+    i = (((size_t) file >> 3) ^ (line * 0x9e3779b1u)) & (MAXSITES - 1);
+
+    while (sites[i].file != NULL)
+    {
+	if (sites[i].file == file && sites[i].line == line)
+	    return i;
+
+	i = (i + 1) & (MAXSITES - 1);
+    }
+
+    if (numsites == MAXSITES - 1)
+    {
+	sites[MAXSITES].file = "(other)";
+	return MAXSITES;
+    }
+
+    numsites++;
+    sites[i].file = file;
+    sites[i].line = line;
+
+    return i;
+}
+
+// Starts the per tic counts over when gametic moves on.
+
+static void Z_StatTic (void)
+{
+    if (gametic == stattic)
+	return;
+
+    stats.ticallocs = ticallocs;
+    stats.ticfrees = ticfrees;
+    stats.ticpurges = ticpurges;
+
+    if (ticallocs > stats.peakticallocs)
+	stats.peakticallocs = ticallocs;
+    if (ticfrees > stats.peakticfrees)
+	stats.peakticfrees = ticfrees;
+    if (ticpurges > stats.peakticpurges)
+	stats.peakticpurges = ticpurges;
+
+    ticallocs = ticfrees = ticpurges = 0;
+    stattic = gametic;
+}
+
+static void Z_CountLive (memblock_t* block, int tag, int size)
+{
+    zonetagstats_t*	t;
+    zonesite_t*		site;
+
+    t = &stats.tags[tag];
+    t->live += size;
+
+    if (t->live > t->peak)
+	t->peak = t->live;
+
+    site = &sites[block->site];
+    site->live += size;
+
+    if (site->live > site->peak)
+	site->peak = site->live;
+}
+
+
+
+static int Z_Log2 (unsigned int n)
+{
+#ifdef __GNUC__
+    return 31 - __builtin_clz (n);
+#else
+    int		result;
+
+    for (result = 0; n > 1; n >>= 1)
+	result++;
+
+    return result;
+#endif
+}
+
+// Class of the free list holding blocks of the given size.
+
+static int Z_FreeClass (unsigned int size)
+{
+    int		fl;
+
+    fl = Z_Log2 (size);
+
+    return (fl << FREECLASSBITS)
+	 | ((size >> (fl - FREECLASSBITS)) & (FREECLASSSTEPS - 1));
+}
+
+// Puts a free block at the front of its list if first is set,
+//  to be taken next, or else at the back.
+
+static void Z_LinkFree (memblock_t* block, boolean first)
+{
+    int		c;
+
+    c = Z_FreeClass (block->size);
+
+    if (freelists[c] == NULL)
+    {
+	block->freeprev = block->freenext = NULL;
+	freelists[c] = freetails[c] = block;
+    }
+    else if (first)
+    {
+	block->freeprev = NULL;
+	block->freenext = freelists[c];
+	block->freenext->freeprev = block;
+	freelists[c] = block;
+    }
+    else
+    {
+	block->freenext = NULL;
+	block->freeprev = freetails[c];
+	block->freeprev->freenext = block;
+	freetails[c] = block;
+    }
+
+    freemap[c >> 5] |= 1u << (c & 31);
+
+    stats.free += block->size;
+}
+
+static void Z_UnlinkFree (memblock_t* block)
+{
+    int		c;
+
+    stats.free -= block->size;
+
+    c = Z_FreeClass (block->size);
+
+    if (block->freenext)
+	block->freenext->freeprev = block->freeprev;
+    else
+	freetails[c] = block->freeprev;
+
+    if (block->freeprev)
+	block->freeprev->freenext = block->freenext;
+    else
+    {
+	freelists[c] = block->freenext;
+
+	if (!freelists[c])
+	    freemap[c >> 5] &= ~(1u << (c & 31));
+    }
+}
+
+//
+// Z_FindFree
+// Takes a free block of at least size bytes off the free lists,
+//  or returns NULL if there is none.
+//
+static memblock_t* Z_FindFree (int size)
+{
+    memblock_t*	block;
+    unsigned int bits;
+    int		fl;
+    int		c;
+    int		i;
+
+    // Every block in a class past the one size falls in is big
+    //  enough: round up to the next class and take the first
+    //  non-empty list from there.
+    fl = Z_Log2 (size);
+    c = Z_FreeClass (size + (1 << (fl - FREECLASSBITS)) - 1);
+
+    for (i = c >> 5; i < NUMFREECLASSES / 32; i++)
+    {
+	bits = freemap[i];
+
+	if (i == c >> 5)
+	    bits &= ~0u << (c & 31);
+
+	if (bits)
+	{
+	    block = freelists[(i << 5) + Z_Log2 (bits & -bits)];
+	    Z_UnlinkFree (block);
+	    return block;
+	}
+    }
+
+    // Nothing larger; some blocks in the class of size itself
+    //  may still do.
+    for (block = freelists[Z_FreeClass (size)]; block; block = block->freenext)
+    {
+	if (block->size >= size)
+	{
+	    Z_UnlinkFree (block);
+	    return block;
+	}
+    }
+
+    return NULL;
+}
+
 
 
 //
@@ -87,6 +393,11 @@ void Z_ClearZone (memzone_t* zone)
     block->tag = PU_FREE;
 
     block->size = zone->size - sizeof(memzone_t);
+
+    memset (freelists, 0, sizeof(freelists));
+    memset (freetails, 0, sizeof(freetails));
+    memset (freemap, 0, sizeof(freemap));
+    Z_LinkFree (block, true);
 }
 
 
@@ -117,6 +428,150 @@ void Z_Init (void)
     block->tag = PU_FREE;
     
     block->size = mainzone->size - sizeof(memzone_t);
+
+    Z_LinkFree (block, true);
+}
+
+
+// Frees a purgable block to make room, counting it as purged.
+
+static void Z_Purge (memblock_t* block)
+{
+    stats.tags[block->tag].purges++;
+    Z_StatTic ();
+    ticpurges++;
+
+    Z_Free ((byte *)block + sizeof(memblock_t));
+}
+
+
+//
+// Z_AddRegion
+// Grows the zone by a region holding a free block of at least
+//  size bytes, and returns that block, or NULL if the zone may
+//  not grow any more.
+//
+static memblock_t* Z_AddRegion (int size)
+{
+    memblock_t*	fence;
+    memblock_t*	block;
+    int		regionsize;
+
+    if (numregions == MAXREGIONS)
+	return NULL;
+
+    regionsize = size + sizeof(memblock_t);
+    fence = (memblock_t *) I_ZoneRegion (&regionsize);
+
+    if (fence == NULL)
+	return NULL;
+
+    fence->size = sizeof(memblock_t);
+    fence->user = NULL;
+    fence->tag = PU_STATIC;
+    fence->id = REGIONID;
+
+    block = fence + 1;
+    block->size = regionsize - sizeof(memblock_t);
+    block->user = NULL;
+    block->tag = PU_FREE;
+    block->id = 0;
+
+    // add to the end of the block list
+    fence->prev = mainzone->blocklist.prev;
+    fence->next = block;
+    block->prev = fence;
+    block->next = &mainzone->blocklist;
+    fence->prev->next = fence;
+    mainzone->blocklist.prev = block;
+
+    Z_LinkFree (block, true);
+
+    mainzone->size += regionsize;
+    regions[numregions].fence = fence;
+    regions[numregions].size = regionsize;
+    numregions++;
+
+    return block;
+}
+
+
+//
+// Z_InGrownRegion
+// True if ptr lies in a region added to the zone, which
+//  Z_ReleaseRegions can only hand back once it holds nothing
+//  but free and purgable blocks.
+//
+boolean Z_InGrownRegion (void* ptr)
+{
+    int		i;
+
+    for (i = 0; i < numregions; i++)
+    {
+	if ((byte *) ptr >= (byte *) regions[i].fence
+	 && (byte *) ptr < (byte *) regions[i].fence + regions[i].size)
+	{
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+
+//
+// Z_ReleaseRegions
+// Hands back every region added to the zone that holds nothing
+//  but free and purgable blocks, purging them.
+//
+void Z_ReleaseRegions (void)
+{
+    memblock_t*	fence;
+    memblock_t*	block;
+    memblock_t*	prev;
+    memblock_t*	end;
+    int		i;
+
+    for (i = numregions - 1; i >= 0; i--)
+    {
+	fence = regions[i].fence;
+
+	for (end = fence->next;
+	     end != &mainzone->blocklist && end->id != REGIONID;
+	     end = end->next)
+	{
+	    if (end->tag != PU_FREE && end->tag < PU_PURGELEVEL)
+		break;
+	}
+
+	if (end != &mainzone->blocklist && end->id != REGIONID)
+	    continue;
+
+	// back to front, so that each block merges into the
+	//  free block grown before it
+	for (block = end->prev; block != fence; block = prev)
+	{
+	    prev = block->prev;
+
+	    if (block->tag != PU_FREE)
+		Z_Purge (block);
+	}
+
+	// now a single free block
+	block = fence->next;
+	Z_UnlinkFree (block);
+
+	fence->prev->next = end;
+	end->prev = fence->prev;
+	mainzone->rover = mainzone->blocklist.next;
+
+	mainzone->size -= regions[i].size;
+	I_FreeZoneRegion ((byte *) fence, regions[i].size);
+
+	numregions--;
+	memmove (&regions[i], &regions[i + 1],
+		 (numregions - i) * sizeof(*regions));
+    }
 }
 
 
@@ -137,6 +592,16 @@ void Z_Free (void* ptr)
     {
     	// clear the user's mark
 	    *block->user = 0;
+
+	zonepurges++;
+    }
+
+    if (block->tag != PU_FREE)
+    {
+	Z_CountLive (block, block->tag, -block->size);
+	stats.tags[block->tag].frees++;
+	Z_StatTic ();
+	ticfrees++;
     }
 
     // mark as free
@@ -149,6 +614,7 @@ void Z_Free (void* ptr)
     if (other->tag == PU_FREE)
     {
         // merge with previous free block
+        Z_UnlinkFree (other);
         other->size += block->size;
         other->next = block->next;
         other->next->prev = other;
@@ -163,6 +629,7 @@ void Z_Free (void* ptr)
     if (other->tag == PU_FREE)
     {
         // merge the next free block onto the end
+        Z_UnlinkFree (other);
         block->size += other->size;
         block->next = other->next;
         block->next->prev = block;
@@ -170,6 +637,8 @@ void Z_Free (void* ptr)
         if (other == mainzone->rover)
             mainzone->rover = block;
     }
+
+    Z_LinkFree (block, false);
 }
 
 
@@ -181,72 +650,254 @@ void Z_Free (void* ptr)
 #define MINFRAGMENT		64
 
 
+//
+// Z_Compact
+// Slides purgable blocks down over the free block before them,
+//  wherever that joins it to another free block.
+// The owners are pointed at the new place, but a moved block is
+//  overwritten at once, unlike a purged one; only call this
+//  where nobody holds a raw pointer into a purgable block, as
+//  between frames.  Does nothing unless Z_Malloc has had to
+//  purge for want of a free block that was big enough.
+//
+void Z_Compact (void)
+{
+    memblock_t*	block;
+    memblock_t*	moved;
+    memblock_t*	prev;
+    memblock_t*	next;
+    int		freesize;
+
+    if (!compactwanted)
+	return;
+
+    compactwanted = false;
+    block = mainzone->blocklist.next;
+
+    while (block != &mainzone->blocklist)
+    {
+	if (block->tag != PU_FREE)
+	{
+	    block = block->next;
+	    continue;
+	}
+
+	// only worth it if a free block lies past the purgable run
+	for (next = block->next; next->tag >= PU_PURGELEVEL; next = next->next)
+	    ;
+
+	if (next->tag != PU_FREE || next == block->next)
+	{
+	    block = next;
+	    continue;
+	}
+
+	Z_UnlinkFree (block);
+
+	do
+	{
+	    freesize = block->size;
+	    prev = block->prev;
+	    next = block->next->next;
+
+	    moved = block;
+	    memmove (moved, block->next, block->next->size);
+	    moved->prev = prev;
+	    prev->next = moved;
+
+	    *moved->user = (byte *)moved + sizeof(memblock_t);
+	    zonepurges++;
+	    stats.moves++;
+
+	    // the hole is now after the moved block
+	    block = (memblock_t *) ((byte *)moved + moved->size);
+	    block->size = freesize;
+	    block->tag = PU_FREE;
+	    block->user = NULL;
+	    block->id = 0;
+	    block->prev = moved;
+	    block->next = next;
+	    moved->next = block;
+	    next->prev = block;
+	} while (next->tag != PU_FREE);
+
+	// merge with the free block at the end of the run,
+	//  which may start another run
+	Z_UnlinkFree (next);
+	block->size += next->size;
+	block->next = next->next;
+	block->next->prev = block;
+
+	Z_LinkFree (block, false);
+    }
+
+    mainzone->rover = mainzone->blocklist.next;
+}
+
+
+//
+// Z_MakeRoom
+// Called when no free block is big enough: purges the run of
+//  free and purgable blocks, at least size bytes long, whose
+//  most recently used block is the oldest, and returns the
+//  free block left behind.
+// The search starts at the rover and stops once MAXSCAN blocks
+//  have been walked and some run has been found, so a big zone
+//  is looked through a part at a time.
+//
+static memblock_t* Z_MakeRoom (int size)
+{
+    memblock_t*	block;
+    memblock_t*	start;
+    memblock_t*	first;
+    memblock_t*	best;
+    memblock_t*	before;
+    boolean	sawfirst;
+    int		newest;
+    int		bestnewest;
+    int		total;
+    int		scanned;
+
+    // with enough free space overall, joining up the holes
+    //  would have made room without losing anything
+    if (stats.free >= size)
+	compactwanted = true;
+
+    best = NULL;
+    bestnewest = 0;
+    scanned = 0;
+
+    first = mainzone->rover;
+
+    if (first == &mainzone->blocklist)
+	first = first->next;
+
+    start = first;
+
+    while (1)
+    {
+	total = 0;
+	newest = -1;
+	sawfirst = false;
+
+	for (block = start; total < size; block = block->next)
+	{
+	    scanned++;
+
+	    if (block == first && block != start)
+		sawfirst = true;
+
+	    if (block->tag != PU_FREE)
+	    {
+		if (block->tag < PU_PURGELEVEL)
+		    break;
+
+		if (block->lastuse > newest)
+		    newest = block->lastuse;
+	    }
+
+	    // no better than one already found
+	    if (best != NULL && newest >= bestnewest)
+		break;
+
+	    total += block->size;
+	}
+
+	if (total >= size)
+	{
+	    best = start;
+	    bestnewest = newest;
+	}
+	else if (block->tag != PU_FREE && block->tag < PU_PURGELEVEL)
+	{
+	    // no run starting before this block gets past it
+	    if (sawfirst)
+		break;
+
+	    start = block;
+	}
+
+	start = start->next;
+
+	if (start == &mainzone->blocklist)
+	    start = start->next;
+
+	if (start == first || (best != NULL && scanned >= MAXSCAN))
+	    break;
+    }
+
+    stats.scans++;
+    stats.scanned += scanned;
+
+    if (scanned > stats.maxscan)
+	stats.maxscan = scanned;
+
+    if (best == NULL)
+    {
+	// nothing left to purge that would do
+	block = Z_AddRegion (size);
+
+	if (block == NULL)
+	    I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
+
+	Z_UnlinkFree (block);
+
+	return block;
+    }
+
+    // Purge the run back to front, so that each block merges
+    //  into the free block grown before it.
+    before = best->prev;
+
+    for (total = 0, block = best; total < size; block = block->next)
+	total += block->size;
+
+    for (block = block->prev; block != before; block = start)
+    {
+	start = block->prev;
+
+	if (block->tag != PU_FREE)
+	    Z_Purge (block);
+    }
+
+    block = before->next;
+
+    if (before->tag == PU_FREE)
+	block = before;
+
+    Z_UnlinkFree (block);
+
+    return block;
+}
+
+
+//
+// Z_Malloc
+// Called through the Z_Malloc macro, which passes the
+//  call site for the telemetry.
+//
 void*
-Z_Malloc
+Z_Malloc2
 ( int		size,
   int		tag,
-  void*		user )
+  void*		user,
+  char*		file,
+  int		line )
 {
     int		extra;
-    memblock_t*	start;
-    memblock_t* rover;
     memblock_t* newblock;
     memblock_t*	base;
     void *result;
 
     size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
-    
-    // scan through the block list,
-    // looking for the first free block
-    // of sufficient size,
-    // throwing out any purgable blocks along the way.
 
     // account for size of block header
     size += sizeof(memblock_t);
-    
-    // if there is a free block behind the rover,
-    //  back up over them
-    base = mainzone->rover;
-    
-    if (base->prev->tag == PU_FREE)
-        base = base->prev;
-	
-    rover = base;
-    start = base->prev;
-	
-    do
-    {
-        if (rover == start)
-        {
-            // scanned all the way around the list
-            I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
-        }
-	
-        if (rover->tag != PU_FREE)
-        {
-            if (rover->tag < PU_PURGELEVEL)
-            {
-                // hit a block that can't be purged,
-                // so move base past it
-                base = rover = rover->next;
-            }
-            else
-            {
-                // free the rover block (adding the size to base)
-
-                // the rover can be the base block
-                base = base->prev;
-                Z_Free ((byte *)rover+sizeof(memblock_t));
-                base = base->next;
-                rover = base->next;
-            }
-        }
-        else
-        {
-            rover = rover->next;
-        }
-
-    } while (base->tag != PU_FREE || base->size < size);
+
+    base = Z_FindFree (size);
+
+    if (base == NULL)
+        base = Z_MakeRoom (size);
 
     
     // found a block big enough
@@ -266,6 +917,8 @@ Z_Malloc
 
         base->next = newblock;
         base->size = size;
+
+        Z_LinkFree (newblock, true);
     }
 	
 	if (user == NULL && tag >= PU_PURGELEVEL)
@@ -285,6 +938,14 @@ Z_Malloc
     mainzone->rover = base->next;	
 	
     base->id = ZONEID;
+    base->lastuse = gametic;
+    base->site = Z_SiteIndex (file, line);
+
+    Z_CountLive (base, tag, base->size);
+    stats.tags[tag].allocs++;
+    sites[base->site].allocs++;
+    Z_StatTic ();
+    ticallocs++;
     
     return result;
 }
@@ -349,7 +1010,8 @@ Z_DumpHeap
 	    break;
 	}
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
+	if ( (byte *)block + block->size != (byte *)block->next
+	     && block->next->id != REGIONID)
 	    printf ("ERROR: block size does not touch the next block\n");
 
 	if ( block->next->prev != block)
@@ -381,7 +1043,8 @@ void Z_FileDumpHeap (FILE* f)
 	    break;
 	}
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
+	if ( (byte *)block + block->size != (byte *)block->next
+	     && block->next->id != REGIONID)
 	    fprintf (f,"ERROR: block size does not touch the next block\n");
 
 	if ( block->next->prev != block)
@@ -400,6 +1063,39 @@ void Z_FileDumpHeap (FILE* f)
 void Z_CheckHeap (void)
 {
     memblock_t*	block;
+    int		freeblocks;
+    int		c;
+
+    // every free list entry must be a free block of its class
+    freeblocks = 0;
+
+    for (c = 0; c < NUMFREECLASSES; c++)
+    {
+	if (!freelists[c] != !(freemap[c >> 5] & (1u << (c & 31))))
+	    I_Error ("Z_CheckHeap: free list map out of date\n");
+
+	for (block = freelists[c]; block; block = block->freenext)
+	{
+	    if (block->tag != PU_FREE || Z_FreeClass (block->size) != c)
+		I_Error ("Z_CheckHeap: bad block on a free list\n");
+
+	    if (block->freenext == NULL && block != freetails[c])
+		I_Error ("Z_CheckHeap: free list tail out of date\n");
+
+	    freeblocks++;
+	}
+    }
+
+    for (block = mainzone->blocklist.next ;
+	 block != &mainzone->blocklist ;
+	 block = block->next)
+    {
+	if (block->tag == PU_FREE)
+	    freeblocks--;
+    }
+
+    if (freeblocks != 0)
+	I_Error ("Z_CheckHeap: free lists do not match the free blocks\n");
 	
     for (block = mainzone->blocklist.next ; ; block = block->next)
     {
@@ -409,7 +1105,8 @@ void Z_CheckHeap (void)
 	    break;
 	}
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
+	if ( (byte *)block + block->size != (byte *)block->next
+	     && block->next->id != REGIONID)
 	    I_Error ("Z_CheckHeap: block size does not touch the next block\n");
 
 	if ( block->next->prev != block)
@@ -440,7 +1137,28 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line)
         I_Error("%s:%i: Z_ChangeTag: an owner is required "
                 "for purgable blocks", file, line);
 
+    Z_CountLive (block, block->tag, -block->size);
+    Z_CountLive (block, tag, block->size);
+
     block->tag = tag;
+    block->lastuse = gametic;
+}
+
+//
+// Z_Touch
+// Marks a block as in use this tic, without changing its tag,
+//  so that it is purged after blocks that have not been used.
+//
+void Z_Touch (void *ptr)
+{
+    memblock_t*	block;
+
+    block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID)
+        I_Error("Z_Touch: block without a ZONEID!");
+
+    block->lastuse = gametic;
 }
 
 void Z_ChangeUser(void *ptr, void **user)
@@ -486,3 +1204,258 @@ unsigned int Z_ZoneSize(void)
     return mainzone->size;
 }
 
+//
+// Z_PurgeCount
+// Bumped every time a block with an owner is released,
+//  whether purged by Z_Malloc or dropped by a cache,
+//  and every time Z_Malloc moves one.
+// Lets callers holding bare pointers into cached data
+//  find out whether any of it may have gone away.
+//
+unsigned int Z_PurgeCount(void)
+{
+    return zonepurges;
+}
+
+
+
+//
+// POOLS
+// Each object has a one word header in front of it: the pool
+//  it came from while in use, the next free object once freed.
+// The object itself is left alone when freed, as vanilla code
+//  such as P_RunThinkers reads a thinker after freeing it.
+//
+// Freed objects are reused oldest first, and never during the
+//  tic they were freed in, so that a stale pointer to a removed
+//  mobj keeps seeing the removed mobj for a while, as it mostly
+//  did with the zone rover.
+//
+
+#define ARENABLOCK	16384
+
+typedef union poolobj_u
+{
+    pool_t*		pool;
+    union poolobj_u*	nextfree;
+} poolobj_t;
+
+
+//
+// Z_PoolAlloc
+//
+void* Z_PoolAlloc (pool_t* pool)
+{
+    arena_t*	arena;
+    poolobj_t*	obj;
+    byte*	block;
+
+    arena = pool->arena;
+
+    if (pool->stride == 0)
+    {
+	pool->stride = sizeof(poolobj_t)
+		     + ((pool->size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1));
+
+	if (pool->stride > ARENABLOCK - (int) sizeof(void *))
+	    I_Error ("Z_PoolAlloc: %i byte objects do not fit an arena block",
+		     pool->size);
+
+	pool->next = arena->pools;
+	arena->pools = pool;
+    }
+
+    obj = pool->freelist;
+
+    if (obj != NULL && (obj != pool->fresh || pool->freshtic != gametic))
+    {
+	pool->freelist = obj->nextfree;
+
+	if (pool->freelist == NULL)
+	    pool->freetail = NULL;
+
+	if (obj == pool->fresh)
+	    pool->fresh = NULL;
+    }
+    else
+    {
+	if (arena->left < pool->stride)
+	{
+	    // the rest of the newest block is wasted
+	    block = Z_Malloc (ARENABLOCK, arena->tag, NULL);
+	    *(void **) block = arena->blocks;
+	    arena->blocks = block;
+	    arena->left = ARENABLOCK - sizeof(void *);
+	}
+
+	obj = (poolobj_t *) ((byte *)arena->blocks + ARENABLOCK - arena->left);
+	arena->left -= pool->stride;
+    }
+
+    obj->pool = pool;
+
+    return obj + 1;
+}
+
+
+//
+// Z_PoolFree
+//
+void Z_PoolFree (void* ptr)
+{
+    poolobj_t*	obj;
+    pool_t*	pool;
+
+    obj = (poolobj_t *) ptr - 1;
+    pool = obj->pool;
+
+    obj->nextfree = NULL;
+
+    if (pool->freetail != NULL)
+	((poolobj_t *) pool->freetail)->nextfree = obj;
+    else
+	pool->freelist = obj;
+
+    pool->freetail = obj;
+
+    if (pool->fresh == NULL || pool->freshtic != gametic)
+    {
+	pool->fresh = obj;
+	pool->freshtic = gametic;
+    }
+}
+
+
+//
+// Z_PoolOf
+// The pool a live object was allocated from.
+//
+pool_t* Z_PoolOf (void* ptr)
+{
+    return ((poolobj_t *) ptr - 1)->pool;
+}
+
+
+//
+// Z_ClearArena
+// Frees the arena's zone blocks, and with them every object
+//  of every pool carved from it.
+//
+void Z_ClearArena (arena_t* arena)
+{
+    pool_t*	pool;
+    void*	block;
+
+    while (arena->blocks != NULL)
+    {
+	block = arena->blocks;
+	arena->blocks = *(void **) block;
+	Z_Free (block);
+    }
+
+    arena->left = 0;
+
+    for (pool = arena->pools; pool != NULL; pool = pool->next)
+    {
+	pool->freelist = NULL;
+	pool->freetail = NULL;
+	pool->fresh = NULL;
+    }
+}
+
+
+
+//
+// Z_GetStats
+// Fills in the telemetry, and the free space figures that are
+//  worked out from the free lists when asked for.
+//
+void Z_GetStats (zonestats_t* s)
+{
+    memblock_t*	block;
+    int		c;
+
+    Z_StatTic ();
+
+    *s = stats;
+    s->size = mainzone->size;
+    s->regions = numregions + 1;
+    s->largestfree = 0;
+
+    // the largest free block is in the highest non-empty class
+    for (c = NUMFREECLASSES - 1; c >= 0; c--)
+    {
+	if (freelists[c] != NULL)
+	{
+	    for (block = freelists[c]; block; block = block->freenext)
+	    {
+		if (block->size > s->largestfree)
+		    s->largestfree = block->size;
+	    }
+
+	    break;
+	}
+    }
+
+    if (s->free > 0)
+	s->fragmentation = (int) (100.0 * (s->free - s->largestfree) / s->free);
+    else
+	s->fragmentation = 0;
+}
+
+
+static int Z_ComparePeaks (const void* a, const void* b)
+{
+    return ((const zonesite_t *) b)->peak - ((const zonesite_t *) a)->peak;
+}
+
+//
+// Z_DumpStats
+// Prints the telemetry, with the call sites that have held
+//  the most memory at once.
+//
+void Z_DumpStats (FILE* f)
+{
+    zonestats_t	s;
+    zonesite_t	top[MAXSITES + 1];
+    int		i;
+
+    Z_GetStats (&s);
+
+    fprintf (f, "zone: %i KiB in %i regions, %i KiB free, "
+		"largest free block %i KiB, %i%% fragmented\n",
+	     s.size / 1024, s.regions, s.free / 1024,
+	     s.largestfree / 1024, s.fragmentation);
+
+    fprintf (f, "  %-10s %9s %9s %9s %9s %9s\n",
+	     "tag", "live KiB", "peak KiB", "allocs", "frees", "purges");
+
+    for (i = PU_STATIC; i < PU_NUM_TAGS; i++)
+    {
+	if (i == PU_FREE)
+	    continue;
+
+	fprintf (f, "  %-10s %9i %9i %9u %9u %9u\n", tagnames[i],
+		 s.tags[i].live / 1024, s.tags[i].peak / 1024,
+		 s.tags[i].allocs, s.tags[i].frees, s.tags[i].purges);
+    }
+
+    fprintf (f, "  last tic: %u allocs, %u frees, %u purges; "
+		"peak %u, %u, %u\n",
+	     s.ticallocs, s.ticfrees, s.ticpurges,
+	     s.peakticallocs, s.peakticfrees, s.peakticpurges);
+
+    fprintf (f, "  %u scans for room, %u blocks walked, at most %u; "
+		"%u blocks moved\n",
+	     s.scans, s.scanned, s.maxscan, s.moves);
+
+    memcpy (top, sites, sizeof(top));
+    qsort (top, MAXSITES + 1, sizeof(*top), Z_ComparePeaks);
+
+    for (i = 0; i < 16 && top[i].peak > 0; i++)
+    {
+	fprintf (f, "  %s:%i: peak %i KiB, live %i KiB, %u allocs\n",
+		 top[i].file, top[i].line, top[i].peak / 1024,
+		 top[i].live / 1024, top[i].allocs);
+    }
+}
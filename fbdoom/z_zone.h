@@ -26,6 +26,8 @@
 
 #include <stdio.h>
 
+#include "doomtype.h"
+
 //
 // ZONE MEMORY
 // PU - purge tags.
@@ -51,16 +53,21 @@ enum
         
 
 void	Z_Init (void);
-void*	Z_Malloc (int size, int tag, void *ptr);
+void*	Z_Malloc2 (int size, int tag, void *ptr, char *file, int line);
 void    Z_Free (void *ptr);
 void    Z_FreeTags (int lowtag, int hightag);
 void    Z_DumpHeap (int lowtag, int hightag);
 void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
+void    Z_ReleaseRegions (void);
+boolean Z_InGrownRegion (void *ptr);
+void    Z_Compact (void);
 void    Z_ChangeTag2 (void *ptr, int tag, char *file, int line);
 void    Z_ChangeUser(void *ptr, void **user);
+void    Z_Touch (void *ptr);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
+unsigned int Z_PurgeCount(void);
 
 //
 // This is used to get the local FILE:LINE info from CPP
@@ -69,5 +76,82 @@ unsigned int Z_ZoneSize(void);
 #define Z_ChangeTag(p,t)                                       \
     Z_ChangeTag2((p), (t), __FILE__, __LINE__)
 
+#define Z_Malloc(s,t,p)                                        \
+    Z_Malloc2((s), (t), (p), __FILE__, __LINE__)
+
+
+//
+// TELEMETRY
+//
+
+typedef struct
+{
+    int			live;		// bytes in blocks with the tag
+    int			peak;		// the most there have been
+    unsigned int	allocs;
+    unsigned int	frees;		// including purges
+    unsigned int	purges;		// freed by Z_Malloc to make room
+} zonetagstats_t;
+
+typedef struct
+{
+    zonetagstats_t	tags[PU_NUM_TAGS];
+
+    int			size;		// of the zone, in all its regions
+    int			regions;
+    int			free;		// bytes in free blocks
+    int			largestfree;
+    int			fragmentation;	// percent of free bytes outside
+					//  the largest free block
+
+    // during the last complete tic, and the most in any tic
+    unsigned int	ticallocs, ticfrees, ticpurges;
+    unsigned int	peakticallocs, peakticfrees, peakticpurges;
+
+    unsigned int	scans;		// times Z_Malloc walked the blocks
+    unsigned int	scanned;	// blocks walked by them
+    unsigned int	maxscan;
+    unsigned int	moves;		// blocks moved by compaction
+} zonestats_t;
+
+void	Z_GetStats (zonestats_t* stats);
+void	Z_DumpStats (FILE* f);
+
+
+//
+// POOLS
+// Fixed size objects carved out of an arena of zone blocks.
+// An arena is released in one go by Z_ClearArena, along with
+// the free lists of every pool carved from it.
+//
+
+typedef struct pool_s pool_t;
+
+typedef struct
+{
+    int		tag;		// of the zone blocks carved up
+    void*	blocks;		// newest first, chained through the first word
+    int		left;		// bytes not yet carved from the newest block
+    pool_t*	pools;		// pools that have carved from the arena
+} arena_t;
+
+struct pool_s
+{
+    int		size;		// of an object
+    arena_t*	arena;
+
+    int		stride;		// object and its header, 0 until first used
+    void*	freelist;	// oldest freed first
+    void*	freetail;
+    void*	fresh;		// first on freelist freed during freshtic
+    int		freshtic;
+    pool_t*	next;		// in arena->pools
+};
+
+void*	Z_PoolAlloc (pool_t* pool);
+void	Z_PoolFree (void* ptr);
+pool_t*	Z_PoolOf (void* ptr);
+void	Z_ClearArena (arena_t* arena);
+
 
 #endif